@@ -1,7 +1,9 @@
 #include "devices/block.h"
+#include <inttypes.h>
 #include <list.h>
 #include <string.h>
 #include <stdio.h>
+#include <iostat.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
 
@@ -19,6 +21,14 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    unsigned long long read_reqs;       /* Number of read requests. */
+    unsigned long long write_reqs;      /* Number of write requests. */
+    unsigned long long seq_reqs;        /* Requests starting at NEXT_SECTOR. */
+    unsigned long long random_reqs;     /* Other requests. */
+    block_sector_t next_sector;         /* Sector after the last request. */
+    unsigned max_waiters;               /* Peak of block_waiters(). */
+    uint32_t read_hist[IOSTAT_HIST_CNT];  /* Read latency histogram. */
+    uint32_t write_hist[IOSTAT_HIST_CNT]; /* Write latency histogram. */
   };
 
 /* List of all block devices. */
@@ -28,6 +38,10 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static uint64_t begin_request (struct block *, block_sector_t sector,
+                               block_sector_t cnt);
+static void end_request (uint32_t hist[IOSTAT_HIST_CNT], uint64_t start);
+static void print_hist (const char *op, const uint32_t hist[IOSTAT_HIST_CNT]);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -119,8 +133,13 @@ check_sector (struct block *block, block_sector_t sector)
    per-block device locking is unneeded. */
 void
 block_read (struct block *block, block_sector_t sector, void *buffer) {
+  uint64_t start;
+
   check_sector (block, sector);
+  start = begin_request (block, sector, 1);
   block->ops->read (block->aux, sector, buffer);
+  end_request (block->read_hist, start);
+  block->read_reqs++;
   block->read_cnt++;
 }
 
@@ -132,12 +151,77 @@ block_read (struct block *block, block_sector_t sector, void *buffer) {
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
+  uint64_t start;
+
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
+  start = begin_request (block, sector, 1);
   block->ops->write (block->aux, sector, buffer);
+  end_request (block->write_hist, start);
+  block->write_reqs++;
   block->write_cnt++;
 }
 
+/* Reads CNT consecutive sectors starting at SECTOR from BLOCK
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Drivers that can transfer several sectors per command
+   do so; for the rest this is the same as CNT calls to
+   block_read().
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     block_sector_t cnt, void *buffer)
+{
+  block_sector_t i;
+  uint64_t start;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  start = begin_request (block, sector, cnt);
+  if (block->ops->read_multiple != NULL)
+    block->ops->read_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->read (block->aux, sector + i,
+                        (uint8_t *) buffer + i * BLOCK_SECTOR_SIZE);
+  end_request (block->read_hist, start);
+  block->read_reqs++;
+  block->read_cnt += cnt;
+}
+
+/* Writes CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block device has acknowledged receiving all
+   of the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      block_sector_t cnt, const void *buffer)
+{
+  block_sector_t i;
+  uint64_t start;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  start = begin_request (block, sector, cnt);
+  if (block->ops->write_multiple != NULL)
+    block->ops->write_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->write (block->aux, sector + i,
+                         (const uint8_t *) buffer + i * BLOCK_SECTOR_SIZE);
+  end_request (block->write_hist, start);
+  block->write_reqs++;
+  block->write_cnt += cnt;
+}
+
 /* Returns the number of sectors in BLOCK. */
 block_sector_t
 block_size (struct block *block)
@@ -159,13 +243,37 @@ block_type (struct block *block)
   return block->type;
 }
 
+/* Fills in the counters and histograms in ST with BLOCK's
+   statistics. */
+void
+block_get_stats (struct block *block, struct iostat *st)
+{
+  st->read_cnt = block->read_cnt;
+  st->write_cnt = block->write_cnt;
+  st->read_reqs = block->read_reqs;
+  st->write_reqs = block->write_reqs;
+  st->seq_reqs = block->seq_reqs;
+  st->random_reqs = block->random_reqs;
+  st->max_waiters = block->max_waiters;
+  memcpy (st->read_hist, block->read_hist, sizeof st->read_hist);
+  memcpy (st->write_hist, block->write_hist, sizeof st->write_hist);
+}
+
+/* Returns the number of requests that currently hold or wait for
+   the hardware behind BLOCK, or 0 if its driver does not say. */
+unsigned
+block_waiters (struct block *block)
+{
+  return block->ops->waiters != NULL ? block->ops->waiters (block->aux) : 0;
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void
 block_print_stats (void)
 {
   int i;
 
-  for (i = 0; i < BLOCK_CNT; i++)
+  for (i = 0; i < BLOCK_ROLE_CNT; i++)
     {
       struct block *block = block_by_role[i];
       if (block != NULL)
@@ -173,6 +281,15 @@ block_print_stats (void)
           printf ("%s (%s): %llu reads, %llu writes\n",
                   block->name, block_type_name (block->type),
                   block->read_cnt, block->write_cnt);
+          printf ("  %llu read requests (%llu bytes), "
+                  "%llu write requests (%llu bytes)\n",
+                  block->read_reqs, block->read_cnt * BLOCK_SECTOR_SIZE,
+                  block->write_reqs, block->write_cnt * BLOCK_SECTOR_SIZE);
+          printf ("  %llu sequential, %llu random; "
+                  "at most %u ahead on the channel\n",
+                  block->seq_reqs, block->random_reqs, block->max_waiters);
+          print_hist ("read", block->read_hist);
+          print_hist ("write", block->write_hist);
         }
     }
 }
@@ -199,6 +316,14 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->read_reqs = 0;
+  block->write_reqs = 0;
+  block->seq_reqs = 0;
+  block->random_reqs = 0;
+  block->next_sector = 0;
+  block->max_waiters = 0;
+  memset (block->read_hist, 0, sizeof block->read_hist);
+  memset (block->write_hist, 0, sizeof block->write_hist);
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -219,3 +344,67 @@ list_elem_to_block (struct list_elem *list_elem)
           ? list_entry (list_elem, struct block, list_elem)
           : NULL);
 }
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Records the start of a request for CNT sectors of BLOCK
+   beginning at SECTOR: whether it continues where the previous
+   request left off, and how many requests are ahead of it.
+   Returns the time stamp to pass to end_request(). */
+static uint64_t
+begin_request (struct block *block, block_sector_t sector,
+               block_sector_t cnt)
+{
+  unsigned waiters = block_waiters (block);
+
+  if (sector == block->next_sector)
+    block->seq_reqs++;
+  else
+    block->random_reqs++;
+  block->next_sector = sector + cnt;
+  if (waiters > block->max_waiters)
+    block->max_waiters = waiters;
+  return rdtsc ();
+}
+
+/* Adds the time since START to latency histogram HIST. */
+static void
+end_request (uint32_t hist[IOSTAT_HIST_CNT], uint64_t start)
+{
+  uint64_t cycles = rdtsc () - start;
+  int bucket = 0;
+
+  while (cycles > 1 && bucket < IOSTAT_HIST_CNT - 1)
+    {
+      cycles >>= 1;
+      bucket++;
+    }
+  hist[bucket]++;
+}
+
+/* Prints the nonempty buckets of latency histogram HIST, if any,
+   for operation OP. */
+static void
+print_hist (const char *op, const uint32_t hist[IOSTAT_HIST_CNT])
+{
+  int i;
+  bool any = false;
+
+  for (i = 0; i < IOSTAT_HIST_CNT; i++)
+    if (hist[i] != 0)
+      {
+        if (!any)
+          printf ("  %s latency (log2 cycles: count):", op);
+        printf (" %d: %"PRIu32, i, hist[i]);
+        any = true;
+      }
+  if (any)
+    printf ("\n");
+}
@@ -53,11 +53,18 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, block_sector_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, block_sector_t cnt,
+                           const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
 /* Statistics. */
+struct iostat;
 void block_print_stats (void);
+void block_get_stats (struct block *, struct iostat *);
+unsigned block_waiters (struct block *);
 
 /* Lower-level interface to block device drivers. */
 
@@ -65,6 +72,19 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional.  Transfer CNT consecutive sectors in one request.
+       If null, the block layer falls back to one call to READ or
+       WRITE per sector. */
+    void (*read_multiple) (void *aux, block_sector_t, block_sector_t cnt,
+                           void *buffer);
+    void (*write_multiple) (void *aux, block_sector_t, block_sector_t cnt,
+                            const void *buffer);
+
+    /* Optional.  Returns how many requests currently hold or are
+       waiting for the hardware behind the device, for
+       statistics. */
+    unsigned (*waiters) (void *aux);
   };
 
 struct block *block_register (const char *name, enum block_type,
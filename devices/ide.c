@@ -50,6 +50,9 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Most sectors one READ/WRITE SECTOR command can transfer. */
+#define MAX_SECTORS_PER_CMD 256
+
 /* An ATA device. */
 struct ata_disk
   {
@@ -85,7 +88,8 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sector (struct ata_disk *, block_sector_t,
+                           block_sector_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -347,7 +351,7 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
+  select_sector (d, sec_no, 1);
   issue_pio_command (c, CMD_READ_SECTOR_RETRY);
   sema_down (&c->completion_wait);
   if (!wait_while_busy (d))
@@ -367,7 +371,7 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
+  select_sector (d, sec_no, 1);
   issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
   if (!wait_while_busy (d))
     PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
@@ -376,24 +380,116 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   lock_release (&c->lock);
 }
 
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes.  Each
+   command moves up to MAX_SECTORS_PER_CMD sectors; the disk
+   interrupts once per sector as its data becomes ready.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read_multiple (void *d_, block_sector_t sec_no, block_sector_t cnt,
+                   void *buffer_)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  uint8_t *buffer = buffer_;
+
+  lock_acquire (&c->lock);
+  while (cnt > 0)
+    {
+      block_sector_t n = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      block_sector_t i;
+
+      select_sector (d, sec_no, n);
+      issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+      for (i = 0; i < n; i++)
+        {
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                   d->name, sec_no + i);
+          input_sector (c, buffer);
+          buffer += BLOCK_SECTOR_SIZE;
+        }
+      sec_no += n;
+      cnt -= n;
+    }
+  lock_release (&c->lock);
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after the disk has acknowledged receiving all of the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no, block_sector_t cnt,
+                    const void *buffer_)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  const uint8_t *buffer = buffer_;
+
+  lock_acquire (&c->lock);
+  while (cnt > 0)
+    {
+      block_sector_t n = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      block_sector_t i;
+
+      select_sector (d, sec_no, n);
+      issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+      for (i = 0; i < n; i++)
+        {
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                   d->name, sec_no + i);
+          output_sector (c, buffer);
+          buffer += BLOCK_SECTOR_SIZE;
+          sema_down (&c->completion_wait);
+        }
+      sec_no += n;
+      cnt -= n;
+    }
+  lock_release (&c->lock);
+}
+
+/* Returns the number of threads holding or waiting for the
+   channel that disk D is attached to. */
+static unsigned
+ide_waiters (void *d_)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  enum intr_level old_level = intr_disable ();
+  unsigned cnt = list_size (&c->lock.semaphore.waiters)
+                 + (c->lock.holder != NULL);
+  intr_set_level (old_level);
+  return cnt;
+}
+
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple,
+    ide_waiters
   };
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.)  A count of
+   MAX_SECTORS_PER_CMD is written as 0, as ATA specifies. */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == MAX_SECTORS_PER_CMD ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
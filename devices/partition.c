@@ -319,8 +319,34 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
   block_write (p->block, p->start + sector, buffer);
 }
 
+static void
+partition_read_multiple (void *p_, block_sector_t sector, block_sector_t cnt,
+                         void *buffer)
+{
+  struct partition *p = p_;
+  block_read_multiple (p->block, p->start + sector, cnt, buffer);
+}
+
+static void
+partition_write_multiple (void *p_, block_sector_t sector,
+                          block_sector_t cnt, const void *buffer)
+{
+  struct partition *p = p_;
+  block_write_multiple (p->block, p->start + sector, cnt, buffer);
+}
+
+static unsigned
+partition_waiters (void *p_)
+{
+  struct partition *p = p_;
+  return block_waiters (p->block);
+}
+
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    partition_read_multiple,
+    partition_write_multiple,
+    partition_waiters
   };
@@ -24,38 +24,39 @@ list_dir (const char *dir, bool verbose)
 
   if (isdir (dir_fd))
     {
-      char name[READDIR_MAX_LEN];
+      char buffer[1024];
+      int size;
 
       printf ("%s", dir);
       if (verbose)
         printf (" (inumber %d)", inumber (dir_fd));
       printf (":\n");
 
-      while (readdir (dir_fd, name)) 
+      /* Each readdir_bulk() call returns a batch of entries, and
+         with READDIR_STAT their types and sizes too, so we need
+         neither a trap per name nor an open() per file. */
+      while ((size = readdir_bulk (dir_fd, buffer, sizeof buffer,
+                                   verbose ? READDIR_STAT : 0)) > 0)
         {
-          printf ("%s", name); 
-          if (verbose) 
-            {
-              char full_name[128];
-              int entry_fd;
+          int ofs;
 
-              snprintf (full_name, sizeof full_name, "%s/%s", dir, name);
-              entry_fd = open (full_name);
+          for (ofs = 0; ofs < size; )
+            {
+              struct dirent *d = (struct dirent *) (buffer + ofs);
 
-              printf (": ");
-              if (entry_fd != -1)
+              printf ("%s", d->d_name);
+              if (verbose)
                 {
-                  if (isdir (entry_fd))
+                  printf (": ");
+                  if (d->d_type == DT_DIR)
                     printf ("directory");
                   else
-                    printf ("%d-byte file", filesize (entry_fd));
-                  printf (", inumber %d", inumber (entry_fd));
+                    printf ("%d-byte file", d->d_size);
+                  printf (", inumber %d", d->d_ino);
                 }
-              else
-                printf ("open failed");
-              close (entry_fd);
+              printf ("\n");
+              ofs += d->d_reclen;
             }
-          printf ("\n");
         }
     }
   else 
@@ -0,0 +1,570 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/inode.h"
+#include "filesys/tmpfs.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Most pages the cache holds at once.  They come from the kernel
+   pool, so that caching file data never takes frames away from
+   user processes. */
+#define CACHE_PAGE_CNT 64
+
+/* Most pages cache_prefetch() reads in one request. */
+#define PREFETCH_MAX 16
+
+/* A page of file data. */
+struct cache_page
+  {
+    struct hash_elem hash_elem;         /* Element in `pages'. */
+    struct list_elem lru_elem;          /* Element in `lru'. */
+    struct inode *inode;                /* File the data belongs to. */
+    off_t offset;                       /* Page-aligned offset in the file. */
+    uint8_t *kpage;                     /* The data. */
+    int pin_cnt;                        /* User mappings plus copies in
+                                           progress; pinned pages are
+                                           never evicted. */
+    int writer_cnt;                     /* Writable user mappings. */
+    bool dirty;                         /* Modified through a mapping
+                                           since last written back? */
+    bool busy;                          /* Being read in or evicted, with
+                                           the lock released for I/O. */
+  };
+
+static struct hash pages;               /* All cached pages. */
+static struct list lru;                 /* Least recently used first. */
+static size_t page_cnt;                 /* Number of cached pages. */
+static struct lock cache_lock;          /* Protects all of the above.
+                                           Never held across disk I/O. */
+static struct condition io_done;        /* A busy page stopped being so. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static struct cache_page *find (struct inode *, off_t offset);
+static struct cache_page *lookup (struct inode *, off_t offset);
+static struct cache_page *get_page (struct inode *, off_t offset);
+static struct cache_page *add_page (struct inode *, off_t offset);
+static void write_page (struct cache_page *);
+static void flush (struct inode *);
+static void evict (struct cache_page *);
+
+/* Initializes the page cache. */
+void
+cache_init (void)
+{
+  hash_init (&pages, page_hash, page_less, NULL);
+  list_init (&lru);
+  lock_init (&cache_lock);
+  cond_init (&io_done);
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+   OFFSET, by way of the page cache.  Returns the number of bytes
+   actually read, which may be less than SIZE if end of file is
+   reached. */
+off_t
+cache_read (struct inode *inode, void *buffer_, off_t size, off_t offset)
+{
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  /* Directories are read and written in place by directory.c,
+     and tmpfs data is in memory already. */
+  if (inode_is_dir (inode) || tmpfs_owns (inode_get_inumber (inode)))
+    return inode_read_at (inode, buffer, size, offset);
+
+  while (size > 0)
+    {
+      off_t page_ofs = offset % PGSIZE;
+      off_t inode_left = inode_length (inode) - offset;
+      off_t page_left = PGSIZE - page_ofs;
+      off_t chunk_size = size < page_left ? size : page_left;
+      struct cache_page *p;
+
+      if (inode_left < chunk_size)
+        chunk_size = inode_left;
+      if (chunk_size <= 0)
+        break;
+
+      lock_acquire (&cache_lock);
+      p = get_page (inode, offset - page_ofs);
+      if (p != NULL)
+        p->pin_cnt++;
+      lock_release (&cache_lock);
+
+      if (p != NULL)
+        {
+          /* Copy without holding the lock: BUFFER may be user
+             memory whose page fault needs the cache. */
+          memcpy (buffer + bytes_read, p->kpage + page_ofs, chunk_size);
+
+          lock_acquire (&cache_lock);
+          p->pin_cnt--;
+          lock_release (&cache_lock);
+        }
+      else
+        {
+          /* Every cached page is pinned.  Read around the cache. */
+          chunk_size = inode_read_at (inode, buffer + bytes_read,
+                                      chunk_size, offset);
+          if (chunk_size == 0)
+            break;
+        }
+
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_read += chunk_size;
+    }
+
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   The data goes straight to the disk and into any cached copy of
+   the pages it touches.  Returns the number of bytes actually
+   written, which may be less than SIZE if end of file is reached
+   or writes are denied. */
+off_t
+cache_write (struct inode *inode, const void *buffer_, off_t size,
+             off_t offset)
+{
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = inode_write_at (inode, buffer, size, offset);
+  off_t done;
+
+  if (inode_is_dir (inode) || tmpfs_owns (inode_get_inumber (inode)))
+    return bytes_written;
+
+  for (done = 0; done < bytes_written; )
+    {
+      off_t page_ofs = (offset + done) % PGSIZE;
+      off_t page_left = PGSIZE - page_ofs;
+      off_t chunk_size = bytes_written - done;
+      struct cache_page *p;
+
+      if (page_left < chunk_size)
+        chunk_size = page_left;
+
+      lock_acquire (&cache_lock);
+      p = lookup (inode, offset + done - page_ofs);
+      if (p != NULL)
+        p->pin_cnt++;
+      lock_release (&cache_lock);
+
+      if (p != NULL)
+        {
+          memcpy (p->kpage + page_ofs, buffer + done, chunk_size);
+
+          lock_acquire (&cache_lock);
+          p->pin_cnt--;
+          lock_release (&cache_lock);
+        }
+      done += chunk_size;
+    }
+
+  return bytes_written;
+}
+
+/* Brings the pages of INODE that hold the SIZE bytes at OFFSET,
+   which must be page-aligned, into the cache ahead of need.  Each
+   run of pages not cached yet is read with a single
+   inode_read_at(), so that contiguous sectors move in one request
+   rather than one request per page.  Gives up quietly if memory or
+   room in the cache runs short. */
+void
+cache_prefetch (struct inode *inode, off_t offset, off_t size)
+{
+  off_t end;
+
+  ASSERT (offset % PGSIZE == 0);
+
+  if (inode_is_dir (inode) || tmpfs_owns (inode_get_inumber (inode)))
+    return;
+
+  end = inode_length (inode);
+  if (size < end - offset)
+    end = offset + size;
+  while (offset < end)
+    {
+      struct cache_page *run[PREFETCH_MAX];
+      uint8_t *buffer;
+      size_t cnt, i;
+
+      /* Claim the run of uncached pages starting at OFFSET.  The
+         claimed pages stay busy, so nobody uses them, until they
+         are filled in below. */
+      lock_acquire (&cache_lock);
+      for (cnt = 0; cnt < PREFETCH_MAX
+             && offset + (off_t) cnt * PGSIZE < end; cnt++)
+        {
+          run[cnt] = add_page (inode, offset + cnt * PGSIZE);
+          if (run[cnt] == NULL)
+            break;
+        }
+      if (cnt == 0)
+        {
+          bool cached = find (inode, offset) != NULL;
+          lock_release (&cache_lock);
+          if (!cached)
+            break;
+          offset += PGSIZE;
+          continue;
+        }
+      lock_release (&cache_lock);
+
+      /* Bytes past end of file stay zero.  Without memory for the
+         whole run, read it a page at a time. */
+      buffer = palloc_get_multiple (PAL_ZERO, cnt);
+      if (buffer != NULL)
+        {
+          inode_read_at (inode, buffer, cnt * PGSIZE, offset);
+          for (i = 0; i < cnt; i++)
+            memcpy (run[i]->kpage, buffer + i * PGSIZE, PGSIZE);
+          palloc_free_multiple (buffer, cnt);
+        }
+      else
+        for (i = 0; i < cnt; i++)
+          inode_read_at (inode, run[i]->kpage, PGSIZE, run[i]->offset);
+
+      lock_acquire (&cache_lock);
+      for (i = 0; i < cnt; i++)
+        run[i]->busy = false;
+      cond_broadcast (&io_done, &cache_lock);
+      lock_release (&cache_lock);
+
+      offset += cnt * PGSIZE;
+    }
+}
+
+/* Returns the kernel address of the cached page at OFFSET in
+   INODE, reading it in if necessary, and pins it so that it can
+   be mapped into a user process, writable if WRITABLE is true.
+   Returns a null pointer if the cache has no room, or INODE is in
+   tmpfs, which the cache does not hold, in which case the caller
+   should fall back to a private copy of the data. */
+void *
+cache_map (struct inode *inode, off_t offset, bool writable)
+{
+  struct cache_page *p;
+
+  ASSERT (offset % PGSIZE == 0);
+
+  if (tmpfs_owns (inode_get_inumber (inode)))
+    return NULL;
+
+  lock_acquire (&cache_lock);
+  p = get_page (inode, offset);
+  if (p != NULL)
+    {
+      p->pin_cnt++;
+      if (writable)
+        p->writer_cnt++;
+    }
+  lock_release (&cache_lock);
+
+  return p != NULL ? p->kpage : NULL;
+}
+
+/* Releases a mapping obtained from cache_map() with the same
+   WRITABLE.  DIRTY says whether the user process wrote to the
+   page, in which case it is written back when it leaves the
+   cache. */
+void
+cache_unmap (struct inode *inode, off_t offset, bool writable, bool dirty)
+{
+  struct cache_page *p;
+
+  lock_acquire (&cache_lock);
+  p = lookup (inode, offset);
+  ASSERT (p != NULL && p->pin_cnt > 0);
+  p->pin_cnt--;
+  if (writable)
+    {
+      ASSERT (p->writer_cnt > 0);
+      p->writer_cnt--;
+    }
+  if (dirty)
+    p->dirty = true;
+  lock_release (&cache_lock);
+}
+
+/* Writes INODE's cached pages that are dirty, or mapped writable
+   and so may be, back to its data sectors. */
+void
+cache_flush (struct inode *inode)
+{
+  flush (inode);
+}
+
+/* Writes back and discards all of INODE's cached pages.  Called
+   when INODE's last opener closes it. */
+void
+cache_drop (struct inode *inode)
+{
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      struct cache_page *p = NULL;
+      struct list_elem *e;
+
+      for (e = list_begin (&lru); e != list_end (&lru); e = list_next (e))
+        {
+          p = list_entry (e, struct cache_page, lru_elem);
+          if (p->inode == inode)
+            break;
+        }
+      if (e == list_end (&lru))
+        break;
+
+      if (p->busy)
+        cond_wait (&io_done, &cache_lock);
+      else
+        {
+          ASSERT (p->pin_cnt == 0);
+          evict (p);
+        }
+    }
+  lock_release (&cache_lock);
+}
+
+/* Writes every cached page that is dirty, or mapped writable,
+   back to disk. */
+void
+cache_flush_all (void)
+{
+  flush (NULL);
+}
+
+/* Returns a hash value for cached page P. */
+static unsigned
+page_hash (const struct hash_elem *p_, void *aux UNUSED)
+{
+  const struct cache_page *p = hash_entry (p_, struct cache_page, hash_elem);
+  return hash_bytes (&p->inode, sizeof p->inode) ^ hash_int (p->offset);
+}
+
+/* Returns true if cached page A precedes cached page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct cache_page *a = hash_entry (a_, struct cache_page, hash_elem);
+  const struct cache_page *b = hash_entry (b_, struct cache_page, hash_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  return a->offset < b->offset;
+}
+
+/* Returns the cached page at OFFSET in INODE, busy or not, or a
+   null pointer if it is not cached. */
+static struct cache_page *
+find (struct inode *inode, off_t offset)
+{
+  struct cache_page key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  key.inode = inode;
+  key.offset = offset;
+  e = hash_find (&pages, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct cache_page, hash_elem) : NULL;
+}
+
+/* Returns the cached page at OFFSET in INODE, or a null pointer
+   if it is not cached.  If the page is being read in or evicted,
+   waits for that to finish first. */
+static struct cache_page *
+lookup (struct inode *inode, off_t offset)
+{
+  struct cache_page *p;
+
+  while ((p = find (inode, offset)) != NULL && p->busy)
+    cond_wait (&io_done, &cache_lock);
+  return p;
+}
+
+/* Returns the cached page at OFFSET in INODE, reading it from
+   disk if it is not already cached, and marks it most recently
+   used.  Returns a null pointer if the cache is full of pinned
+   pages or memory is short. */
+static struct cache_page *
+get_page (struct inode *inode, off_t offset)
+{
+  struct cache_page *p = lookup (inode, offset);
+
+  if (p != NULL)
+    {
+      list_remove (&p->lru_elem);
+      list_push_back (&lru, &p->lru_elem);
+      return p;
+    }
+
+  p = add_page (inode, offset);
+  if (p == NULL)
+    {
+      /* Another thread may have cached the page while add_page()
+         had the lock released. */
+      p = lookup (inode, offset);
+      return p;
+    }
+
+  /* Read without holding the lock, so that one miss does not hold
+     up every other user of the cache.  P is busy meanwhile. */
+  lock_release (&cache_lock);
+  inode_read_at (inode, p->kpage, PGSIZE, offset);
+  lock_acquire (&cache_lock);
+  p->busy = false;
+  cond_broadcast (&io_done, &cache_lock);
+  return p;
+}
+
+/* Adds a zeroed, busy page for OFFSET in INODE as the most
+   recently used, evicting as needed, and returns it for the caller
+   to fill in and then mark not busy.  Returns a null pointer if
+   OFFSET in INODE is cached already, which it may have become if
+   eviction released the lock, or if the cache is full of pinned
+   pages or memory is short. */
+static struct cache_page *
+add_page (struct inode *inode, off_t offset)
+{
+  struct cache_page *p;
+
+  while (page_cnt >= CACHE_PAGE_CNT)
+    {
+      struct cache_page *victim = NULL;
+      struct list_elem *e;
+
+      if (find (inode, offset) != NULL)
+        return NULL;
+
+      /* Evict the least recently used unpinned page. */
+      for (e = list_begin (&lru); e != list_end (&lru); e = list_next (e))
+        {
+          victim = list_entry (e, struct cache_page, lru_elem);
+          if (victim->pin_cnt == 0 && !victim->busy)
+            break;
+        }
+      if (e == list_end (&lru))
+        return NULL;
+      evict (victim);
+    }
+  if (find (inode, offset) != NULL)
+    return NULL;
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->kpage = palloc_get_page (PAL_ZERO);
+  if (p->kpage == NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  p->inode = inode;
+  p->offset = offset;
+  p->pin_cnt = 0;
+  p->writer_cnt = 0;
+  p->dirty = false;
+  p->busy = true;
+
+  hash_insert (&pages, &p->hash_elem);
+  list_push_back (&lru, &p->lru_elem);
+  page_cnt++;
+  return p;
+}
+
+/* Writes P's data to disk.  Data past end of file, which a
+   mapping may have scribbled on, is not written.  Called without
+   the cache lock, with P pinned or busy so that it stays put. */
+static void
+write_page (struct cache_page *p)
+{
+  if (!p->inode->removed)
+    {
+      off_t length = inode_length (p->inode) - p->offset;
+      if (length > 0)
+        inode_write_at (p->inode, p->kpage,
+                        length < PGSIZE ? length : PGSIZE, p->offset);
+    }
+}
+
+/* Writes back the cached pages of INODE, or of every inode if
+   INODE is null, that are dirty or mapped writable.  A writable
+   mapping sets only the page table's dirty bit, which the cache
+   does not see until the page is unmapped, so such pages are
+   written whether or not they have changed. */
+static void
+flush (struct inode *inode)
+{
+  struct cache_page *todo[CACHE_PAGE_CNT];
+  struct list_elem *e;
+  size_t cnt = 0, i;
+
+  lock_acquire (&cache_lock);
+
+  /* Let reads and evictions under way finish, so that every page
+     evicted before the flush is on disk when it returns. */
+ retry:
+  for (e = list_begin (&lru); e != list_end (&lru); e = list_next (e))
+    {
+      struct cache_page *p = list_entry (e, struct cache_page, lru_elem);
+      if ((inode == NULL || p->inode == inode) && p->busy)
+        {
+          cond_wait (&io_done, &cache_lock);
+          goto retry;
+        }
+    }
+
+  for (e = list_begin (&lru); e != list_end (&lru); e = list_next (e))
+    {
+      struct cache_page *p = list_entry (e, struct cache_page, lru_elem);
+      if ((inode == NULL || p->inode == inode)
+          && (p->dirty || p->writer_cnt > 0))
+        {
+          p->dirty = false;
+          p->pin_cnt++;
+          todo[cnt++] = p;
+        }
+    }
+  lock_release (&cache_lock);
+
+  for (i = 0; i < cnt; i++)
+    write_page (todo[i]);
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cnt; i++)
+    todo[i]->pin_cnt--;
+  lock_release (&cache_lock);
+}
+
+/* Writes back P if it is dirty and removes it from the cache.
+   Releases the cache lock during the write, with P busy so that
+   lookups of it wait until it is gone. */
+static void
+evict (struct cache_page *p)
+{
+  ASSERT (p->pin_cnt == 0 && !p->busy);
+
+  p->busy = true;
+  if (p->dirty)
+    {
+      p->dirty = false;
+      lock_release (&cache_lock);
+      write_page (p);
+      lock_acquire (&cache_lock);
+    }
+  hash_delete (&pages, &p->hash_elem);
+  list_remove (&p->lru_elem);
+  page_cnt--;
+  cond_broadcast (&io_done, &cache_lock);
+  palloc_free_page (p->kpage);
+  free (p);
+}
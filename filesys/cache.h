@@ -1,61 +1,34 @@
 #ifndef FILESYS_CACHE_H
 #define FILESYS_CACHE_H
 
-struct cache_block;
+#include <stdbool.h>
+#include "filesys/off_t.h"
 
-//Reserve block in b_cache to hold sector
-// we could evict some other unused buffer
-// grant exclusive / shared access
-struct cache_block *cache_get_block(disk_sector_t, bool exclusive);
+/* Page cache.
 
-//release access
-void cache_put_block(struct cache_block *);
+   Holds file data a page at a time, indexed by (inode, page
+   offset), so that every reader of a file shares one copy:
+   read() copies out of the cached page, write() writes through
+   to the disk and into the cached page, and a page fault in an
+   mmap()'d region maps the cached page itself into the faulting
+   process.  Pages stay cached while their inode is open.
+   cache_flush() writes back pages mapped writable as well as
+   those known to be dirty, since stores through a mapping are
+   seen only when it is torn down. */
 
-//read cache from block -> pointer to data
-void* cache_read_block(struct cache_block *);
+struct inode;
 
-//fill cache block with zeroes -> ptr to data
-void* cache_zero_block(struct cache_block *);
+void cache_init (void);
+off_t cache_read (struct inode *, void *, off_t size, off_t offset);
+off_t cache_write (struct inode *, const void *, off_t size, off_t offset);
 
-//mark dirty (wb cache)
-void cache_mark_block_dirty(struct cache_block *);
+void cache_prefetch (struct inode *, off_t offset, off_t size);
 
-//init cache
-void cache_block_init(void);
+void *cache_map (struct inode *, off_t offset, bool writable);
+void cache_unmap (struct inode *, off_t offset, bool writable, bool dirty);
 
-void cache_block_read_ahead(void);
+void cache_flush (struct inode *);
+void cache_drop (struct inode *);
+void cache_flush_all (void);
 
-void cache_block_shutdown(void);
-
-#endif
-
-//per block locking
-//multiple reader single writer
-//lru @ stack
-
-/*
-
-b = cache_get_block(n, _);
-cache_read_block(b);
-cache_readahead(next(n));
-
-
-queue q;
-cache_readahead(Sector s) {
-  q.lock()
-  q.add(requests(S));
-  qcond.signal()
-  q.unlock
-}
-
-cache_read_ahead_daemon()
-  while(true)
-    q.lock()
-    while (q.empty())
-      qcond.wait()
-    s = q.pop()
-    q.unlock()
-    read sector s
-
-
-*/
+#endif /* filesys/cache.h */
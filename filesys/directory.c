@@ -1,4 +1,5 @@
 #include "filesys/directory.h"
+#include <dirent.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
@@ -22,11 +23,33 @@ struct dir_entry
   }; // @ size 20B called entry_cnt @ 16 -> 320B (?)
 
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+   given SECTOR, inside the directory in PARENT_SECTOR.  Every
+   directory but the root starts out with a ".." entry that leads
+   back to its parent; the root, which is its own parent, needs
+   none.  Returns true if successful, false on failure. */
 bool
-dir_create (block_sector_t sector, size_t entry_cnt)
+dir_create (block_sector_t sector, size_t entry_cnt,
+            block_sector_t parent_sector)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir_entry e;
+  struct inode *inode;
+  bool success;
+
+  if (!inode_create (sector, entry_cnt * sizeof e, true))
+    return false;
+  if (sector == parent_sector)
+    return true;
+
+  memset (&e, 0, sizeof e);
+  e.inode_sector = parent_sector;
+  strlcpy (e.name, "..", sizeof e.name);
+  e.in_use = true;
+
+  inode = inode_open (sector);
+  success = (inode != NULL
+             && inode_write_at (inode, &e, sizeof e, 0) == sizeof e);
+  inode_close (inode);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -65,6 +88,25 @@ dir_reopen (struct dir *dir)
   return dir_open (inode_reopen (dir->inode));
 }
 
+/* Sets the position at which dir_readdir() and dir_readdir_bulk()
+   next read DIR to NEW_POS, a value returned by dir_tell(). */
+void
+dir_seek (struct dir *dir, off_t new_pos)
+{
+  ASSERT (dir != NULL);
+  ASSERT (new_pos >= 0);
+  dir->pos = new_pos;
+}
+
+/* Returns the position at which dir_readdir() and
+   dir_readdir_bulk() next read DIR. */
+off_t
+dir_tell (struct dir *dir)
+{
+  ASSERT (dir != NULL);
+  return dir->pos;
+}
+
 /* Destroys DIR and frees associated resources. */
 void
 dir_close (struct dir *dir)
@@ -111,8 +153,27 @@ lookup (const struct dir *dir, const char *name,
   return false;
 }
 
+/* Returns true if NAME is "." or "..", which every directory
+   implicitly contains and which cannot be created or removed. */
+static bool
+is_dot_name (const char *name)
+{
+  return !strcmp (name, ".") || !strcmp (name, "..");
+}
+
+/* Returns true if E is an entry that readers of the directory
+   should see, that is, one in use other than "..". */
+static bool
+is_visible (const struct dir_entry *e)
+{
+  return e->in_use && strcmp (e->name, "..");
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
+   "." names DIR itself, and ".." names its parent, which for the
+   root directory is the root directory.  A directory that has
+   been removed contains nothing, not even "." and "..".
    On success, sets *INODE to an inode for the file, otherwise to
    a null pointer.  The caller must close *INODE. */
 bool
@@ -124,7 +185,13 @@ dir_lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
+  if (inode_is_removed (dir->inode))
+    *inode = NULL;
+  else if (!strcmp (name, ".")
+           || (!strcmp (name, "..")
+               && inode_get_inumber (dir->inode) == ROOT_DIR_SECTOR))
+    *inode = inode_reopen (dir->inode);
+  else if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
@@ -136,8 +203,8 @@ dir_lookup (const struct dir *dir, const char *name,
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
    Returns true if successful, false on failure.
-   Fails if NAME is invalid (i.e. too long) or a disk or memory
-   error occurs. */
+   Fails if NAME is invalid (i.e. too long, "." or ".."), if DIR
+   has been removed, or if a disk or memory error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
@@ -149,7 +216,9 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   ASSERT (name != NULL);
 
   /* Check NAME for validity. */
-  if (*name == '\0' || strlen (name) > NAME_MAX)
+  if (*name == '\0' || strlen (name) > NAME_MAX || is_dot_name (name))
+    return false;
+  if (inode_is_removed (dir->inode))
     return false;
 
   /* Check that NAME is not in use. */
@@ -178,9 +247,26 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   return success;
 }
 
+/* Returns true if directory INODE has no entries besides "..". */
+static bool
+is_empty (struct inode *inode)
+{
+  struct dir_entry e;
+  off_t ofs;
+
+  for (ofs = 0; inode_read_at (inode, &e, sizeof e, ofs) == sizeof e;
+       ofs += sizeof e)
+    if (is_visible (&e))
+      return false;
+  return true;
+}
+
 /* Removes any entry for NAME in DIR.
-   Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   Returns true if successful, false on failure, which occurs if
+   there is no file with the given NAME, if NAME is "." or "..",
+   or if NAME is a directory that is not empty.  A directory that
+   is open, even as some process's working directory, may be
+   removed; lookups in it fail from then on. */
 bool
 dir_remove (struct dir *dir, const char *name)
 {
@@ -193,12 +279,12 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  if (is_dot_name (name) || !lookup (dir, name, &e, &ofs))
     goto done;
 
   /* Open inode. */
   inode = inode_open (e.inode_sector);
-  if (inode == NULL)
+  if (inode == NULL || (inode_is_dir (inode) && !is_empty (inode)))
     goto done;
 
   /* Erase directory entry. */
@@ -226,7 +312,7 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e)
     {
       dir->pos += sizeof e;
-      if (e.in_use)
+      if (is_visible (&e))
         {
           strlcpy (name, e.name, NAME_MAX + 1);
           return true;
@@ -235,6 +321,77 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
   return false;
 }
 
+/* Number of directory entries dir_readdir_bulk() pulls from the
+   directory inode per inode_read_at() call. */
+#define BULK_ENTRIES (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* Packs as many of DIR's remaining entries as fit into the
+   SIZE-byte BUFFER as `struct dirent's, advancing DIR's position
+   past them.  If FLAGS includes READDIR_STAT, also opens each
+   entry's inode to report its type and size.
+   Returns the number of bytes used, 0 if the directory has no
+   more entries, or -1 if SIZE is too small for the next entry. */
+int
+dir_readdir_bulk (struct dir *dir, void *buffer, size_t size, int flags)
+{
+  struct dir_entry entries[BULK_ENTRIES];
+  uint8_t *out = buffer;
+  size_t used = 0;
+
+  for (;;)
+    {
+      off_t bytes = inode_read_at (dir->inode, entries, sizeof entries,
+                                   dir->pos);
+      size_t cnt = bytes / sizeof *entries;
+      size_t i;
+
+      if (cnt == 0)
+        break;
+
+      for (i = 0; i < cnt; i++)
+        {
+          struct dir_entry *e = &entries[i];
+          struct dirent *d;
+          size_t namlen, reclen;
+
+          if (!is_visible (e))
+            {
+              dir->pos += sizeof *e;
+              continue;
+            }
+
+          namlen = strnlen (e->name, NAME_MAX);
+          reclen = DIRENT_RECLEN (namlen);
+          if (used + reclen > size)
+            return used > 0 ? (int) used : -1;
+
+          d = (struct dirent *) (out + used);
+          d->d_reclen = reclen;
+          d->d_namlen = namlen;
+          d->d_ino = e->inode_sector;
+          d->d_type = DT_UNKNOWN;
+          d->d_size = -1;
+          memcpy (d->d_name, e->name, namlen);
+          d->d_name[namlen] = '\0';
+
+          if (flags & READDIR_STAT)
+            {
+              struct inode *inode = inode_open (e->inode_sector);
+              if (inode != NULL)
+                {
+                  d->d_type = inode_is_dir (inode) ? DT_DIR : DT_REG;
+                  d->d_size = inode_length (inode);
+                  inode_close (inode);
+                }
+            }
+
+          used += reclen;
+          dir->pos += sizeof *e;
+        }
+    }
+  return used;
+}
+
 
 
 // CREATE KEYSPACE IF NOT EXISTS instagram WITH REPLICATION = {'class': 'SimpleStrategy', 'replication_factor' : 3}
@@ -1,5 +1,6 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "filesys/cache.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
@@ -66,7 +67,7 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size)
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read = cache_read (file->inode, buffer, size, file->pos);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -78,20 +79,19 @@ file_read (struct file *file, void *buffer, off_t size)
    The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  return cache_read (file->inode, buffer, size, file_ofs);
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the file cannot grow that far.
+   Writing past end of file extends the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size)
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written = cache_write (file->inode, buffer, size, file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
@@ -99,15 +99,55 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the file cannot grow that far.
+   Writing past end of file extends the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs)
 {
-  return inode_write_at (file->inode, buffer, size, file_ofs);
+  return cache_write (file->inode, buffer, size, file_ofs);
+}
+
+/* Bytes file_copy() moves per read and write. */
+#define FILE_COPY_CHUNK (64 * BLOCK_SECTOR_SIZE)
+
+/* Copies up to SIZE bytes from SRC, starting at its current
+   position, to DST at its current position, advancing both.
+   The data passes through one kernel buffer, a chunk at a time,
+   so sector-aligned ranges move as multi-sector transfers.
+   Returns the number of bytes copied, which may be less than
+   SIZE if SRC ends, DST cannot take more, or memory runs out. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  off_t bytes_copied = 0;
+  void *buffer;
+
+  buffer = malloc (size < FILE_COPY_CHUNK ? size : FILE_COPY_CHUNK);
+  if (buffer == NULL)
+    return 0;
+
+  while (size > 0)
+    {
+      off_t chunk_size = size < FILE_COPY_CHUNK ? size : FILE_COPY_CHUNK;
+      off_t bytes_read = file_read (src, buffer, chunk_size);
+      off_t bytes_written = file_write (dst, buffer, bytes_read);
+
+      bytes_copied += bytes_written;
+      if (bytes_written < bytes_read)
+        {
+          /* Leave SRC just past what was copied. */
+          src->pos -= bytes_read - bytes_written;
+          break;
+        }
+      if (bytes_read < chunk_size)
+        break;
+      size -= chunk_size;
+    }
+
+  free (buffer);
+  return bytes_copied;
 }
 
 /* Prevents write operations on FILE's underlying inode
@@ -2,40 +2,72 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
+#include "filesys/refcount.h"
+#include "filesys/romfs.h"
+#include "filesys/tmpfs.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "threads/thread.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* Sectors per file system block. */
+size_t fs_block_sectors = 1;
+
+/* Entries a new directory has room for before it must grow. */
+#define DIR_ENTRY_CNT 16
+
 static void do_format (void);
+static int defrag_dir (struct dir *);
+static struct dir *open_parent (const char *path, char name[NAME_MAX + 1]);
+static int get_next_part (char part[NAME_MAX + 1], const char **srcp);
+static bool create (const char *path, off_t initial_size, bool is_dir);
+static bool skip_mount (const char **pathp, const char *mount);
 
 /* Initializes the file system module.
-   If FORMAT is true, reformats the file system. */
+   If FORMAT is true, reformats the file system with BLOCK_SIZE-byte
+   blocks, which must be a power of two from BLOCK_SECTOR_SIZE to
+   FS_BLOCK_SIZE_MAX; otherwise BLOCK_SIZE is ignored and the block
+   size the file system was formatted with is used. */
 void
-filesys_init (bool format)
+filesys_init (bool format, size_t block_size)
 {
   fs_device = block_get_role (BLOCK_FILESYS);
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  if (!format)
+    block_size = inode_read_block_size (FREE_MAP_SECTOR);
+  if (block_size < BLOCK_SECTOR_SIZE || block_size > FS_BLOCK_SIZE_MAX
+      || (block_size & (block_size - 1)) != 0)
+    PANIC ("unsupported file system block size %zu", block_size);
+  fs_block_sectors = block_size / BLOCK_SECTOR_SIZE;
+
   inode_init (); //list_init (&open_inodes);
   free_map_init ();
+  refcount_init ();
+  cache_init ();
 
   if (format)
     do_format ();
 
   free_map_open ();
+  refcount_scan ();
+  tmpfs_init ();
+  romfs_init ();
 }
 
 /* Shuts down the file system module, writing any unwritten data
    to disk. */
-   //TODO: flush cache
 void
 filesys_done (void)
 {
+  cache_flush_all ();
+  inode_flush_all ();
   free_map_close ();
 }
 
@@ -43,21 +75,20 @@ filesys_done (void)
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
    or if internal memory allocation fails. */
-   //INODE create is only called on free sectors
 bool
 filesys_create (const char *name, off_t initial_size)
 {
-  block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
-  if (!success && inode_sector != 0)
-    free_map_release (inode_sector, 1);
-  dir_close (dir);
+  return create (name, initial_size, false);
+}
 
-  return success;
+/* Creates an empty directory named NAME.
+   Returns true if successful, false otherwise.
+   Fails if a file named NAME already exists,
+   or if internal memory allocation fails. */
+bool
+filesys_mkdir (const char *name)
+{
+  return create (name, 0, true);
 }
 
 /* Opens the file with the given NAME.
@@ -68,37 +99,328 @@ filesys_create (const char *name, off_t initial_size)
 struct file *
 filesys_open (const char *name)
 {
-  struct dir *dir = dir_open_root ();
+  char last[NAME_MAX + 1];
+  const char *rest = name;
+  struct dir *dir;
   struct inode *inode = NULL;
 
+  /* The boot image is flat, so "/rom/NAME" is its file NAME. */
+  if (romfs_mounted () && skip_mount (&rest, ROMFS_MOUNT))
+    {
+      if (get_next_part (last, &rest) > 0 && *rest == '\0')
+        inode = romfs_open_name (last);
+      return file_open (inode);
+    }
+
+  dir = open_parent (name, last);
   if (dir != NULL)
-    dir_lookup (dir, name, &inode);
+    dir_lookup (dir, last, &inode);
   dir_close (dir);
 
   return file_open (inode);
 }
 
+/* Opens the program NAME to execute it.  A NAME without a slash
+   is looked up in the boot image first, so programs packed into
+   it run without being copied into the file system; otherwise,
+   or if the image does not have it, this is filesys_open().
+
+   The image thus wins over the file system: a program in it
+   shadows a file of the same name in the working directory,
+   which "./NAME" or an absolute path still reaches. */
+struct file *
+filesys_open_exec (const char *name)
+{
+  if (strchr (name, '/') == NULL)
+    {
+      struct inode *inode = romfs_open_name (name);
+      if (inode != NULL)
+        return file_open (inode);
+    }
+  return filesys_open (name);
+}
+
+/* Makes the directory named NAME the current thread's working
+   directory.  Returns true if successful, false if NAME does not
+   exist or is not a directory. */
+bool
+filesys_chdir (const char *name)
+{
+  struct thread *t = thread_current ();
+  char last[NAME_MAX + 1];
+  struct dir *dir = open_parent (name, last);
+  struct inode *inode = NULL;
+
+  if (dir != NULL)
+    dir_lookup (dir, last, &inode);
+  dir_close (dir);
+
+  if (inode == NULL || !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return false;
+    }
+  dir = dir_open (inode);
+  if (dir == NULL)
+    return false;
+
+  dir_close (t->cwd);
+  t->cwd = dir;
+  return true;
+}
+
+/* Creates a file named DST_NAME holding the same data as the
+   file named SRC_NAME, without copying it: the two share data
+   sectors until either one writes to them.
+   Returns true if successful, false otherwise.
+   Fails if SRC_NAME does not exist or is a directory, if
+   DST_NAME already exists, if either is in tmpfs, or if internal
+   memory allocation fails. */
+bool
+filesys_clone (const char *src_name, const char *dst_name)
+{
+  block_sector_t inode_sector = 0;
+  char last[NAME_MAX + 1];
+  struct dir *dir = open_parent (src_name, last);
+  struct inode *src = NULL;
+  bool success = (dir != NULL
+                  && dir_lookup (dir, last, &src)
+                  && !inode_is_dir (src));
+
+  dir_close (dir);
+  dir = success ? open_parent (dst_name, last) : NULL;
+  success = (dir != NULL
+             && !tmpfs_owns (inode_get_inumber (dir_get_inode (dir)))
+             && free_map_allocate (1, &inode_sector)
+             && inode_clone (src, inode_sector));
+
+  if (success && !dir_add (dir, last, inode_sector))
+    {
+      /* Undo the clone by deleting it. */
+      struct inode *dst = inode_open (inode_sector);
+      inode_remove (dst);
+      inode_close (dst);
+      inode_sector = 0;
+      success = false;
+    }
+  if (!success && inode_sector != 0)
+    free_map_release (inode_sector, 1);
+  inode_close (src);
+  dir_close (dir);
+
+  return success;
+}
+
 /* Deletes the file named NAME.
    Returns true if successful, false on failure.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
+   Fails if no file named NAME exists, if NAME is a directory
+   that is not empty, or if an internal memory allocation
+   fails. */
 bool
 filesys_remove (const char *name)
+{
+  char last[NAME_MAX + 1];
+  struct dir *dir = open_parent (name, last);
+  bool success = dir != NULL && dir_remove (dir, last);
+  dir_close (dir);
+
+  return success;
+}
+
+/* Moves the data of every fragmented file and directory into a
+   contiguous run of blocks where one is free.  Files stay open
+   and usable throughout; the caller must keep other file system
+   operations out until it returns.
+   Returns the number of files and directories moved. */
+int
+filesys_defrag (void)
 {
   struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  int moved = 0;
+
+  if (dir != NULL)
+    {
+      if (inode_defrag (dir_get_inode (dir)))
+        moved++;
+      moved += defrag_dir (dir);
+      dir_close (dir);
+    }
+  return moved;
+}
+
+/* Defragments every entry of DIR, descending into
+   subdirectories.  Returns the number of inodes moved. */
+static int
+defrag_dir (struct dir *dir)
+{
+  char name[NAME_MAX + 1];
+  int moved = 0;
+
+  while (dir_readdir (dir, name))
+    {
+      struct inode *inode;
+
+      if (!dir_lookup (dir, name, &inode))
+        continue;
+      if (inode_defrag (inode))
+        moved++;
+      if (inode_is_dir (inode))
+        {
+          struct dir *subdir = dir_open (inode_reopen (inode));
+          if (subdir != NULL)
+            {
+              moved += defrag_dir (subdir);
+              dir_close (subdir);
+            }
+        }
+      inode_close (inode);
+    }
+  return moved;
+}
+
+/* Creates a file, or a directory if IS_DIR, at PATH.  A new file
+   is INITIAL_SIZE bytes long.  Returns true if successful, false
+   otherwise. */
+static bool
+create (const char *path, off_t initial_size, bool is_dir)
+{
+  block_sector_t inode_sector = 0;
+  char name[NAME_MAX + 1];
+  struct dir *dir = open_parent (path, name);
+  bool in_tmpfs = (dir != NULL
+                   && tmpfs_owns (inode_get_inumber (dir_get_inode (dir))));
+  bool success = (dir != NULL
+                  && (in_tmpfs
+                      ? tmpfs_allocate (&inode_sector)
+                      : free_map_allocate (1, &inode_sector))
+                  && (is_dir
+                      ? dir_create (inode_sector, DIR_ENTRY_CNT,
+                                    inode_get_inumber (dir_get_inode (dir)))
+                      : inode_create (inode_sector, initial_size, false)));
+
+  if (success && !dir_add (dir, name, inode_sector))
+    {
+      /* Undo the creation by deleting the new inode. */
+      struct inode *inode = inode_open (inode_sector);
+      inode_remove (inode);
+      inode_close (inode);
+      inode_sector = 0;
+      success = false;
+    }
+  if (!success && inode_sector != 0 && !in_tmpfs)
+    free_map_release (inode_sector, 1);
   dir_close (dir);
 
   return success;
 }
-
+
+/* Extracts a file name part from *SRCP into PART, and updates
+   *SRCP so that the next call will return the next file name
+   part.  Returns 1 if successful, 0 at end of string, -1 for a
+   too-long file name part. */
+static int
+get_next_part (char part[NAME_MAX + 1], const char **srcp)
+{
+  const char *src = *srcp;
+  char *dst = part;
+
+  /* Skip leading slashes.  If it's all slashes, we're done. */
+  while (*src == '/')
+    src++;
+  if (*src == '\0')
+    return 0;
+
+  /* Copy up to NAME_MAX characters from SRC to DST.  Add null
+     terminator. */
+  while (*src != '/' && *src != '\0')
+    {
+      if (dst < part + NAME_MAX)
+        *dst++ = *src;
+      else
+        return -1;
+      src++;
+    }
+  *dst = '\0';
+
+  /* Advance source pointer. */
+  *srcp = src;
+  return 1;
+}
+
+/* If PATH, at *PATHP, starts with the mount point MOUNT under the
+   root, such as "/tmp" in "/tmp/x", advances *PATHP past it and
+   returns true. */
+static bool
+skip_mount (const char **pathp, const char *mount)
+{
+  const char *path = *pathp;
+  char part[NAME_MAX + 1];
+
+  if (*path != '/' || get_next_part (part, &path) <= 0
+      || strcmp (part, mount))
+    return false;
+  *pathp = path;
+  return true;
+}
+
+/* Opens the directory that holds the last component of PATH and
+   copies that component into NAME.  A PATH that has no last
+   component, such as "/", names its directory as ".".
+   Absolute paths are walked from the root directory, or from the
+   tmpfs root if they start with its mount point, and relative
+   paths from the current thread's working directory, which stays
+   open while it is current, so a relative lookup never re-walks
+   the path that led to it.
+   Returns a null pointer if PATH is empty, if a directory along
+   it does not exist, or if a component is longer than NAME_MAX.
+   The caller must close the returned directory. */
+static struct dir *
+open_parent (const char *path, char name[NAME_MAX + 1])
+{
+  struct thread *t = thread_current ();
+  char part[NAME_MAX + 1];
+  struct dir *dir;
+  int result;
+
+  if (*path == '\0')
+    return NULL;
+  if (skip_mount (&path, TMPFS_MOUNT))
+    dir = dir_open (inode_open (TMPFS_ROOT_INUMBER));
+  else if (*path == '/' || t->cwd == NULL)
+    dir = dir_open_root ();
+  else
+    dir = dir_reopen (t->cwd);
+
+  strlcpy (name, ".", NAME_MAX + 1);
+  while (dir != NULL && (result = get_next_part (part, &path)) != 0)
+    {
+      /* NAME is not the last component after all: descend into
+         it.  "." leaves DIR as it is. */
+      if (result < 0 || strcmp (name, "."))
+        {
+          struct inode *inode = NULL;
+
+          if (result > 0)
+            dir_lookup (dir, name, &inode);
+          dir_close (dir);
+          dir = NULL;
+          if (inode != NULL && inode_is_dir (inode))
+            dir = dir_open (inode);
+          else
+            inode_close (inode);
+        }
+      strlcpy (name, part, NAME_MAX + 1);
+    }
+  return dir;
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
-  printf ("Formatting file system...");
+  printf ("Formatting file system with %zu-byte blocks...", FS_BLOCK_SIZE);
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, DIR_ENTRY_CNT, ROOT_DIR_SECTOR))
     PANIC ("root directory creation failed");
   free_map_close ();
   printf ("done.\n");
@@ -2,7 +2,9 @@
 #define FILESYS_FILESYS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
+#include "devices/block.h"
 
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
@@ -11,10 +13,25 @@
 /* Block device that contains the file system. */
 struct block *fs_device;
 
-void filesys_init (bool format);
+/* The free map, inodes and directories allocate space in blocks
+   of FS_BLOCK_SIZE bytes, fixed when the file system is
+   formatted.  Devices still transfer BLOCK_SECTOR_SIZE-byte
+   sectors, and a block is addressed by its first sector. */
+extern size_t fs_block_sectors;         /* Sectors per block. */
+#define FS_BLOCK_SIZE (fs_block_sectors * BLOCK_SECTOR_SIZE)
+
+/* Largest block size filesys_init() accepts. */
+#define FS_BLOCK_SIZE_MAX 4096
+
+void filesys_init (bool format, size_t block_size);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
+bool filesys_mkdir (const char *name);
 struct file *filesys_open (const char *name);
+struct file *filesys_open_exec (const char *name);
+bool filesys_chdir (const char *name);
 bool filesys_remove (const char *name);
+bool filesys_clone (const char *src_name, const char *dst_name);
+int filesys_defrag (void);
 
 #endif /* filesys/filesys.h */
@@ -6,46 +6,51 @@
 #include "filesys/inode.h"
 
 static struct file *free_map_file;   /* Free map file. */
-static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct bitmap *free_map;      /* Free map, one bit per block. */
 
-/* Initializes the free map. */
+/* Initializes the free map.  The free map and root directory
+   inodes share the first block. */
 void
 free_map_init (void)
 {
-  free_map = bitmap_create (block_size (fs_device));
+  free_map = bitmap_create (block_size (fs_device) / fs_block_sectors);
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
-  bitmap_mark (free_map, FREE_MAP_SECTOR);
-  bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_mark (free_map, FREE_MAP_SECTOR / fs_block_sectors);
+  bitmap_mark (free_map, ROOT_DIR_SECTOR / fs_block_sectors);
 }
 
-/* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+/* Allocates CNT consecutive blocks from the free map and stores
+   the first sector of the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   blocks were available or if the free_map file could not be
+   written. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
+  size_t block = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  if (block != BITMAP_ERROR
       && free_map_file != NULL
       && !bitmap_write (free_map, free_map_file))
     {
-      bitmap_set_multiple (free_map, sector, cnt, false);
-      sector = BITMAP_ERROR;
+      bitmap_set_multiple (free_map, block, cnt, false);
+      block = BITMAP_ERROR;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  if (block != BITMAP_ERROR)
+    *sectorp = block * fs_block_sectors;
+  return block != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT blocks starting with the one at SECTOR available for
+   use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
-  ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
+  size_t block = sector / fs_block_sectors;
+
+  ASSERT (sector % fs_block_sectors == 0);
+  ASSERT (bitmap_all (free_map, block, cnt));
+  bitmap_set_multiple (free_map, block, cnt, false);
   bitmap_write (free_map, free_map_file);
 }
 
@@ -72,7 +77,7 @@ free_map_close (void)
 void
 free_map_create (void) {
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
@@ -1,5 +1,6 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,6 +10,8 @@
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* List files in the root directory. */
@@ -66,6 +69,94 @@ fsutil_rm (char **argv)
     PANIC ("%s: delete failed\n", file_name);
 }
 
+/* Moves each fragmented file into one contiguous run of
+   sectors. */
+void
+fsutil_defrag (char **argv UNUSED)
+{
+  printf ("Defragmenting file system...\n");
+  printf ("%d files moved.\n", filesys_defrag ());
+}
+
+/* fsutil_extract() streams the archive: a reader thread fills a
+   ring of multi-sector buffers from the scratch device while the
+   caller parses headers and writes file data straight out of
+   those buffers, so reading the archive overlaps with writing
+   the files. */
+#define EXTRACT_CHUNK_SECTORS 64        /* Sectors per ring buffer. */
+#define EXTRACT_RING_CNT 4              /* Number of ring buffers. */
+
+/* State shared between fsutil_extract() and its reader thread. */
+struct extract_ring
+  {
+    struct block *src;                  /* Scratch device. */
+    block_sector_t next;                /* Next sector for the reader. */
+    bool stop;                          /* Tells the reader to quit. */
+    uint8_t *bufs[EXTRACT_RING_CNT];    /* Ring buffers. */
+    block_sector_t cnts[EXTRACT_RING_CNT]; /* Sectors in each buffer;
+                                           0 marks the end. */
+    struct semaphore empty;             /* Buffers the reader may fill. */
+    struct semaphore full;              /* Buffers ready to consume. */
+    struct semaphore done;              /* Up'd as the reader exits. */
+
+    /* Used only by the consumer. */
+    int slot;                           /* Buffer being consumed. */
+    bool held;                          /* Is SLOT valid? */
+    block_sector_t ofs;                 /* Next sector within SLOT. */
+  };
+
+/* Reader thread: fills ring buffers in order until told to stop
+   or the device runs out, then queues an empty buffer. */
+static void
+extract_reader (void *ring_)
+{
+  struct extract_ring *ring = ring_;
+  block_sector_t size = block_size (ring->src);
+  int slot;
+
+  for (slot = 0; ; slot = (slot + 1) % EXTRACT_RING_CNT)
+    {
+      block_sector_t cnt;
+
+      sema_down (&ring->empty);
+      cnt = size - ring->next;
+      if (cnt > EXTRACT_CHUNK_SECTORS)
+        cnt = EXTRACT_CHUNK_SECTORS;
+      if (ring->stop)
+        cnt = 0;
+      block_read_multiple (ring->src, ring->next, cnt, ring->bufs[slot]);
+      ring->next += cnt;
+      ring->cnts[slot] = cnt;
+      sema_up (&ring->full);
+      if (cnt == 0)
+        break;
+    }
+  sema_up (&ring->done);
+}
+
+/* Points *DATA at the next unconsumed sector in RING and returns
+   how many sectors follow it in the same buffer, waiting for the
+   reader if necessary. */
+static block_sector_t
+extract_peek (struct extract_ring *ring, uint8_t **data)
+{
+  while (!ring->held || ring->ofs == ring->cnts[ring->slot])
+    {
+      if (ring->held)
+        {
+          sema_up (&ring->empty);
+          ring->slot = (ring->slot + 1) % EXTRACT_RING_CNT;
+        }
+      sema_down (&ring->full);
+      ring->held = true;
+      ring->ofs = 0;
+      if (ring->cnts[ring->slot] == 0)
+        PANIC ("unexpected end of scratch device");
+    }
+  *data = ring->bufs[ring->slot] + ring->ofs * BLOCK_SECTOR_SIZE;
+  return ring->cnts[ring->slot] - ring->ofs;
+}
+
 /* Extracts a ustar-format tar archive from the scratch block
    device into the Pintos file system. */
 void
@@ -73,32 +164,55 @@ fsutil_extract (char **argv UNUSED)
 {
   static block_sector_t sector = 0;
 
-  struct block *src;
-  void *header, *data;
+  struct extract_ring ring;
+  void *header;
+  int i;
 
   /* Allocate buffers. */
   header = malloc (BLOCK_SECTOR_SIZE);
-  data = malloc (BLOCK_SECTOR_SIZE);
-  if (header == NULL || data == NULL)
+  if (header == NULL)
     PANIC ("couldn't allocate buffers");
+  for (i = 0; i < EXTRACT_RING_CNT; i++)
+    {
+      ring.bufs[i] = malloc (EXTRACT_CHUNK_SECTORS * BLOCK_SECTOR_SIZE);
+      if (ring.bufs[i] == NULL)
+        PANIC ("couldn't allocate buffers");
+    }
 
   /* Open source block device. */
-  src = block_get_role (BLOCK_SCRATCH);
-  if (src == NULL)
+  ring.src = block_get_role (BLOCK_SCRATCH);
+  if (ring.src == NULL)
     PANIC ("couldn't open scratch device");
 
   printf ("Extracting ustar archive from scratch device "
           "into file system...\n");
 
+  /* Start reading ahead. */
+  ring.next = sector;
+  ring.stop = false;
+  ring.slot = 0;
+  ring.held = false;
+  sema_init (&ring.empty, EXTRACT_RING_CNT);
+  sema_init (&ring.full, 0);
+  sema_init (&ring.done, 0);
+  if (thread_create ("extract", PRI_DEFAULT, extract_reader, &ring)
+      == TID_ERROR)
+    PANIC ("couldn't start reader thread");
+
   for (;;)
     {
       const char *file_name;
       const char *error;
       enum ustar_type type;
       int size;
-
-      /* Read and parse ustar header. */
-      block_read (src, sector++, header);
+      uint8_t *data;
+
+      /* Read and parse ustar header.  Copy it out of the ring
+         first, since FILE_NAME points into it. */
+      extract_peek (&ring, &data);
+      memcpy (header, data, BLOCK_SECTOR_SIZE);
+      ring.ofs++;
+      sector++;
       error = ustar_parse_header (header, &file_name, &type, &size);
       if (error != NULL)
         PANIC ("bad ustar header in sector %"PRDSNu" (%s)", sector - 1, error);
@@ -116,23 +230,28 @@ fsutil_extract (char **argv UNUSED)
 
           printf ("Putting '%s' into the file system...\n", file_name);
 
-          /* Create destination file. */
+          /* Create destination file at its final size. */
           if (!filesys_create (file_name, size))
             PANIC ("%s: create failed", file_name);
           dst = filesys_open (file_name);
           if (dst == NULL)
             PANIC ("%s: open failed", file_name);
 
-          /* Do copy. */
+          /* Do copy, as much of the current buffer at a time as
+             the file needs. */
           while (size > 0)
             {
-              int chunk_size = (size > BLOCK_SECTOR_SIZE
-                                ? BLOCK_SECTOR_SIZE
+              block_sector_t avail = extract_peek (&ring, &data);
+              int chunk_size = (size > (int) (avail * BLOCK_SECTOR_SIZE)
+                                ? (int) (avail * BLOCK_SECTOR_SIZE)
                                 : size);
-              block_read (src, sector++, data);
+              block_sector_t chunk_sectors = DIV_ROUND_UP (chunk_size,
+                                                           BLOCK_SECTOR_SIZE);
               if (file_write (dst, data, chunk_size) != chunk_size)
                 PANIC ("%s: write failed with %d bytes unwritten",
                        file_name, size);
+              ring.ofs += chunk_sectors;
+              sector += chunk_sectors;
               size -= chunk_size;
             }
 
@@ -141,16 +260,24 @@ fsutil_extract (char **argv UNUSED)
         }
     }
 
+  /* Stop the reader.  Handing back the buffer we hold guarantees
+     it a free slot in which to see the stop request. */
+  ring.stop = true;
+  if (ring.held)
+    sema_up (&ring.empty);
+  sema_down (&ring.done);
+
   /* Erase the ustar header from the start of the block device,
      so that the extraction operation is idempotent.  We erase
      two blocks because two blocks of zeros are the ustar
      end-of-archive marker. */
   printf ("Erasing ustar archive...\n");
   memset (header, 0, BLOCK_SECTOR_SIZE);
-  block_write (src, 0, header);
-  block_write (src, 1, header);
+  block_write (ring.src, 0, header);
+  block_write (ring.src, 1, header);
 
-  free (data);
+  for (i = 0; i < EXTRACT_RING_CNT; i++)
+    free (ring.bufs[i]);
   free (header);
 }
 
@@ -1,14 +1,48 @@
 #include "filesys/inode.h"
 #include <debug.h>
+#include <lz.h>
 #include <round.h>
+#include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/refcount.h"
+#include "filesys/romfs.h"
+#include "filesys/tmpfs.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/syscall.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* List of open inodes, so that opening a single inode twice
+   returns the same `struct inode'. */
+static struct list open_inodes;
+
+#ifdef FILESYS
+
+/* Appends of up to TAIL_APPEND_MAX bytes do not go to the disk
+   right away.  Instead the sector holding the end of the file is
+   kept in the inode's TAIL buffer and the bytes are added there,
+   along with the new length.  The sector is written when it
+   fills, when the file is closed, when anything other than
+   another small append needs it, and otherwise by a background
+   thread at least every TAIL_FLUSH_TICKS, so that a process
+   logging a line at a time writes each sector about once. */
+#define TAIL_APPEND_MAX 128
+#define TAIL_FLUSH_TICKS TIMER_FREQ
+
+/* Protects open_inodes and every inode's tail buffer. */
+static struct lock tail_lock;
+
+static thread_func tail_flusher NO_RETURN;
+
+#endif
+
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
 static inline size_t
@@ -17,6 +51,212 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
+#ifdef FILESYS
+
+/* Data blocks an inode points to directly. */
+#define DIRECT_CNT 10
+
+/* Block pointers in one indirect block. */
+#define PTRS_PER_BLOCK (FS_BLOCK_SIZE / sizeof (uint32_t))
+
+/* Returns the number of blocks to allocate for an inode SIZE
+   bytes long. */
+static inline size_t
+bytes_to_blocks (off_t size)
+{
+  return DIV_ROUND_UP (size, FS_BLOCK_SIZE);
+}
+
+/* Returns the largest number of data blocks an inode can point
+   to. */
+static inline size_t
+max_blocks (void)
+{
+  return DIRECT_CNT + PTRS_PER_BLOCK + PTRS_PER_BLOCK * PTRS_PER_BLOCK;
+}
+
+/* Returns true if inode number SECTOR is a sector of the file
+   system device, rather than a tmpfs or romfs inode. */
+static inline bool
+on_fs_device (block_sector_t sector)
+{
+  return !tmpfs_owns (sector) && !romfs_owns (sector);
+}
+
+/* Reads the file system block that starts at SECTOR into BUFFER,
+   which must have room for FS_BLOCK_SIZE bytes. */
+static void
+read_block (block_sector_t sector, void *buffer)
+{
+  block_read_multiple (fs_device, sector, fs_block_sectors, buffer);
+}
+
+/* Writes FS_BLOCK_SIZE bytes from BUFFER to the file system block
+   that starts at SECTOR. */
+static void
+write_block (block_sector_t sector, const void *buffer)
+{
+  block_write_multiple (fs_device, sector, fs_block_sectors, buffer);
+}
+
+static block_sector_t inode_unshare_sector (struct inode *, off_t,
+                                            block_sector_t);
+
+/* Writes INODE's tail buffer to disk if it holds unwritten
+   data. */
+static void
+tail_write (struct inode *inode)
+{
+  ASSERT (lock_held_by_current_thread (&tail_lock));
+
+  if (inode->tail_dirty)
+    {
+      block_write (fs_device,
+                   inode_offset_to_sector (&inode->data, inode->tail_ofs),
+                   inode->tail);
+      inode->tail_dirty = false;
+    }
+}
+
+/* Writes INODE's tail buffer to disk if it holds unwritten data,
+   and INODE itself if its length or block pointers changed.
+   With DROP, also forgets the buffered sector, whose disk copy
+   the caller may be about to change. */
+static void
+tail_flush (struct inode *inode, bool drop)
+{
+  ASSERT (lock_held_by_current_thread (&tail_lock));
+
+  tail_write (inode);
+  if (inode->data_dirty)
+    {
+      block_write (fs_device, inode->sector, &inode->data);
+      inode->data_dirty = false;
+    }
+  if (drop)
+    inode->tail_ofs = -1;
+}
+
+/* Calls tail_flush() on INODE if its tail buffer holds a sector
+   that starts before file offset END.  An END of inode_length()
+   plus 1 always flushes. */
+static void
+tail_sync (struct inode *inode, off_t end, bool drop)
+{
+  if (inode->tail == NULL)
+    return;
+  lock_acquire (&tail_lock);
+  if (inode->tail_ofs >= 0 && inode->tail_ofs < end)
+    tail_flush (inode, drop);
+  lock_release (&tail_lock);
+}
+
+/* Appends the SIZE bytes in BUFFER, at most TAIL_APPEND_MAX, to
+   INODE by way of its tail buffer.  The data blocks they go into
+   must already be allocated.  Returns false, having done nothing,
+   if memory is short. */
+static bool
+tail_append (struct inode *inode, const uint8_t *buffer, off_t size)
+{
+  uint8_t data[TAIL_APPEND_MAX];
+  off_t ends[2];
+  int i;
+
+  ASSERT (size > 0 && size <= TAIL_APPEND_MAX);
+
+  /* BUFFER may be user memory, so copy it before taking the lock
+     that a page fault might need. */
+  memcpy (data, buffer, size);
+
+  /* Only a private block may be written in place. */
+  ends[0] = inode->data.length;
+  ends[1] = inode->data.length + size - 1;
+  for (i = 0; i < 2; i++)
+    {
+      block_sector_t sector = inode_offset_to_sector (&inode->data, ends[i]);
+      if (refcount_is_shared (sector))
+        inode_unshare_sector (inode, ends[i], sector);
+    }
+
+  lock_acquire (&tail_lock);
+  if (inode->tail == NULL)
+    {
+      inode->tail = malloc (BLOCK_SECTOR_SIZE);
+      if (inode->tail == NULL)
+        {
+          lock_release (&tail_lock);
+          return false;
+        }
+    }
+
+  for (i = 0; i < size; )
+    {
+      off_t length = inode->data.length;
+      int sector_ofs = length % BLOCK_SECTOR_SIZE;
+      int chunk = BLOCK_SECTOR_SIZE - sector_ofs;
+
+      if (chunk > size - i)
+        chunk = size - i;
+
+      if (inode->tail_ofs != length - sector_ofs)
+        {
+          tail_write (inode);
+          if (sector_ofs > 0)
+            block_read (fs_device, inode_offset_to_sector (&inode->data, length),
+                        inode->tail);
+          else
+            memset (inode->tail, 0, BLOCK_SECTOR_SIZE);
+          inode->tail_ofs = length - sector_ofs;
+        }
+
+      memcpy (inode->tail + sector_ofs, data + i, chunk);
+      inode->data.length += chunk;
+      inode->tail_dirty = true;
+      inode->data_dirty = true;
+
+      /* A full sector will not change again. */
+      if (sector_ofs + chunk == BLOCK_SECTOR_SIZE)
+        tail_write (inode);
+      i += chunk;
+    }
+  lock_release (&tail_lock);
+  return true;
+}
+
+/* Writes every buffered tail sector and changed length to disk. */
+void
+inode_flush_all (void)
+{
+  struct list_elem *e;
+
+  lock_acquire (&tail_lock);
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e))
+    tail_flush (list_entry (e, struct inode, elem), false);
+  lock_release (&tail_lock);
+}
+
+/* Background thread that bounds how long appended data stays in
+   memory.  System calls that extend, defragment or compress a file
+   change its in-memory inode under fileSystemLock, not tail_lock,
+   so the flusher takes fileSystemLock too; otherwise it could write
+   an inode whose length and block pointers are out of step.  The
+   inode is written while the lock is still held, because a write
+   of a copy made under it could land after a newer one. */
+static void
+tail_flusher (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (TAIL_FLUSH_TICKS);
+      lock_acquire (&fileSystemLock);
+      inode_flush_all ();
+      lock_release (&fileSystemLock);
+    }
+}
+
+#endif
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -33,15 +273,15 @@ static block_sector_t byte_to_sector (const struct inode *inode, off_t pos) {
 
 #endif
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
-
 /* Initializes the inode module. */
 void
 inode_init (void)
 {
   list_init (&open_inodes);
+#ifdef FILESYS
+  lock_init (&tail_lock);
+  thread_create ("tail-flush", PRI_DEFAULT, tail_flusher, NULL);
+#endif
 }
 
 /*
@@ -53,12 +293,12 @@ Wires up the indirect pointers in struct inode.
 int extend_inode_direct(struct inode_disk *disk_inode, block_sector_t sectors_to_allocate, bool write_back) {
 
     ASSERT(disk_inode != NULL);
-    ASSERT(disk_inode->sectors_allocated < 10);
+    ASSERT(disk_inode->blocks_allocated < DIRECT_CNT);
 
     if (sectors_to_allocate == 0)
       return 0;
 
-    int max_direct_we_can_allocate = 10 - disk_inode->sectors_allocated;
+    int max_direct_we_can_allocate = DIRECT_CNT - disk_inode->blocks_allocated;
     int count_direct_blocks_to_allocate = sectors_to_allocate > max_direct_we_can_allocate
                                           ? max_direct_we_can_allocate
                                           : sectors_to_allocate;
@@ -68,12 +308,12 @@ int extend_inode_direct(struct inode_disk *disk_inode, block_sector_t sectors_to
     int i = 0;
     if (free_map_allocate(count_direct_blocks_to_allocate, &start)) {
       for (; i < count_direct_blocks_to_allocate; i++)
-        disk_inode->direct_block_sectors[i + disk_inode->sectors_allocated] = i + start;
+        disk_inode->direct_block_sectors[i + disk_inode->blocks_allocated] = start + i * fs_block_sectors;
       goto done;
     } else {
       for (; i < count_direct_blocks_to_allocate; i++) {
         if (free_map_allocate(1, &start)) {
-          disk_inode->direct_block_sectors[i + disk_inode->sectors_allocated] = start;
+          disk_inode->direct_block_sectors[i + disk_inode->blocks_allocated] = start;
         } else {
           PANIC("OUT OF FILE SPACE\n");
         }
@@ -85,7 +325,7 @@ int extend_inode_direct(struct inode_disk *disk_inode, block_sector_t sectors_to
 
    if (write_back)
     block_write(fs_device, disk_inode->sector, disk_inode);
-  disk_inode->sectors_allocated += count_direct_blocks_to_allocate;
+  disk_inode->blocks_allocated += count_direct_blocks_to_allocate;
   return sectors_to_allocate - count_direct_blocks_to_allocate;
 }
 
@@ -94,26 +334,27 @@ int extend_inode_indirect(struct inode_disk *disk_inode, block_sector_t sectors_
   // printf("In extend_inode_indirect\n");
 
   ASSERT(disk_inode != NULL);
-  // printf("disk_inode->sectors_allocated = %d\n", disk_inode->sectors_allocated);
-  ASSERT(disk_inode->sectors_allocated >= 10);
+  // printf("disk_inode->blocks_allocated = %d\n", disk_inode->blocks_allocated);
+  ASSERT(disk_inode->blocks_allocated >= DIRECT_CNT);
 
-  int indirect_blocks_allocated = disk_inode->sectors_allocated - 10;
-  int indirect_blocks_unallocated = 128 - indirect_blocks_allocated;
+  int indirect_blocks_allocated = disk_inode->blocks_allocated - DIRECT_CNT;
+  int indirect_blocks_unallocated = PTRS_PER_BLOCK - indirect_blocks_allocated;
 
   int indirect_blocks_to_allocate = sectors_to_allocate > indirect_blocks_unallocated
                                       ? indirect_blocks_unallocated
                                       : sectors_to_allocate;
 
-  void *mock_sector = malloc(BLOCK_SECTOR_SIZE);
+  void *mock_sector = malloc(FS_BLOCK_SIZE);
 
   if (indirect_blocks_allocated != 0)
-    block_read(fs_device, disk_inode->indirect_block_sector, mock_sector);
+    read_block(disk_inode->indirect_block_sector, mock_sector);
 
   //This function panic's to the kernel if not successful. We can assume it works
   chunk_sector_blocks(mock_sector, indirect_blocks_to_allocate, indirect_blocks_to_allocate, indirect_blocks_allocated);
-  block_write(fs_device, disk_inode->indirect_block_sector, mock_sector);
+  write_block(disk_inode->indirect_block_sector, mock_sector);
+  free(mock_sector);
 
-  disk_inode->sectors_allocated += indirect_blocks_to_allocate;
+  disk_inode->blocks_allocated += indirect_blocks_to_allocate;
   return sectors_to_allocate - indirect_blocks_to_allocate;
 }
 
@@ -125,40 +366,43 @@ int extend_inode_dbl_indirect(struct inode_disk *disk_inode, block_sector_t sect
   if (sectors_to_allocate == 0)
     return 0;
 
-  int sectors_used = disk_inode->sectors_allocated - 10 - 128;
+  int sectors_used = disk_inode->blocks_allocated - DIRECT_CNT - PTRS_PER_BLOCK;
 
-  int current_blocks_used = DIV_ROUND_UP(sectors_used, 128);
-  int blocks_needed = DIV_ROUND_UP(sectors_used + sectors_to_allocate, 128);
+  int current_blocks_used = DIV_ROUND_UP(sectors_used, PTRS_PER_BLOCK);
+  int blocks_needed = DIV_ROUND_UP(sectors_used + sectors_to_allocate, PTRS_PER_BLOCK);
 
-  void *indirect_block = malloc(BLOCK_SECTOR_SIZE);
+  void *indirect_block = malloc(FS_BLOCK_SIZE);
+  if (current_blocks_used > 0)
+    read_block(disk_inode->double_indirect_block, indirect_block);
   if (current_blocks_used != blocks_needed) {
     int diff = blocks_needed - current_blocks_used;
     chunk_sector_blocks(indirect_block, diff, diff, current_blocks_used);
-    block_write(fs_device, disk_inode->double_indirect_block, indirect_block);
+    write_block(disk_inode->double_indirect_block, indirect_block);
   }
 
   // memset(mock_sector, 0, BLOCK_SECTOR_SIZE);
   block_sector_t sector;
 
-  void *block = malloc(BLOCK_SECTOR_SIZE);
+  void *block = malloc(FS_BLOCK_SIZE);
 
   while (sectors_to_allocate > 0) {
-    int base_sector = sectors_used / 128;
-    int sector_ofs = sectors_used % 128;
+    int base_sector = sectors_used / PTRS_PER_BLOCK;
+    int sector_ofs = sectors_used % PTRS_PER_BLOCK;
 
-    int max_sector_to_allocate = 128 - sector_ofs;
+    int max_sector_to_allocate = PTRS_PER_BLOCK - sector_ofs;
     int num_to_allocate_round = max_sector_to_allocate > sectors_to_allocate ? sectors_to_allocate : max_sector_to_allocate;
 
     // block_read(fs_device, disk_inode->double_indirect_block, mock_sector);
     sector = ((uint32_t *)indirect_block) [base_sector];
 
-    block_read(fs_device, sector, block);
+    read_block(sector, block);
     chunk_sector_blocks(block, num_to_allocate_round, num_to_allocate_round, sector_ofs);
-    block_write(fs_device, sector, block);
+    write_block(sector, block);
 
 
     sectors_to_allocate -= num_to_allocate_round;
     sectors_used += num_to_allocate_round;
+    disk_inode->blocks_allocated += num_to_allocate_round;
   }
 
   free(block);
@@ -224,7 +468,7 @@ int extend_inode_dbl_indirect(struct inode_disk *disk_inode, block_sector_t sect
 
 int chunk_sector_blocks(void *page, int num_to_allocate, int chunk_size, int start_idx) {
 
-  ASSERT((num_to_allocate + start_idx) < 128);
+  ASSERT((size_t) (num_to_allocate + start_idx) <= PTRS_PER_BLOCK);
   block_sector_t start;
   int sectors_allocated = 0;
 
@@ -239,7 +483,7 @@ int chunk_sector_blocks(void *page, int num_to_allocate, int chunk_size, int sta
       int i = 0;
       for (; i < chunk_size; i++) {
         int page_idx = sectors_allocated + start_idx;
-        ((uint32_t *)page) [page_idx] = start + i;
+        ((uint32_t *)page) [page_idx] = start + i * fs_block_sectors;
         sectors_allocated++;
       }
     } else {
@@ -267,23 +511,28 @@ block_sector_t get_individual_sector(void) {
     PANIC("Out Of Disk Space");
 }
 
-bool inode_create(block_sector_t sector, off_t length) {
+bool inode_create(block_sector_t sector, off_t length, bool is_dir) {
 
   struct inode_disk *disk_inode = NULL;
   bool success = false;
 
-  ASSERT (length >= 0 && length < 8388608);
+  if (tmpfs_owns(sector))
+    return tmpfs_create(sector, length, is_dir);
+
+  ASSERT (length >= 0 && bytes_to_blocks(length) <= max_blocks());
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
   disk_inode = calloc(1, sizeof *disk_inode);
   if (disk_inode != NULL) {
-    size_t sectors = bytes_to_sectors(length);
-    // size_t sectors_allocated = 0;
+    size_t sectors = bytes_to_blocks(length);
+    // size_t blocks_allocated = 0;
 
-    disk_inode->sectors_allocated = 0;
+    disk_inode->blocks_allocated = 0;
     disk_inode->length = length;
     disk_inode->sector = sector;
+    disk_inode->is_dir = is_dir;
     disk_inode->magic = INODE_MAGIC;
+    disk_inode->block_size = FS_BLOCK_SIZE;
 
     sectors = extend_inode_direct(disk_inode, sectors, false);
     // sectors -= sectors_allocated;
@@ -317,15 +566,15 @@ int release_direct_block(struct inode *inode, int sectors_to_clear) {
   if (sectors_to_clear == 0 || inode == NULL)
     return 0;
 
-  int num_to_free = sectors_to_clear > 10 ? 10 : sectors_to_clear;
+  int num_to_free = sectors_to_clear > DIRECT_CNT ? DIRECT_CNT : sectors_to_clear;
 
   if (is_direct_block_sequential(inode, num_to_free)) {
-    free_map_release(inode->data.direct_block_sectors[0], num_to_free);
+    refcount_release(inode->data.direct_block_sectors[0], num_to_free);
     return sectors_to_clear - num_to_free;
   } else {
     int i = 0;
     for (; i < num_to_free; i++)
-      free_map_release(inode->data.direct_block_sectors[i], 1);
+      refcount_release(inode->data.direct_block_sectors[i], 1);
 
     return sectors_to_clear - num_to_free;
   }
@@ -333,7 +582,7 @@ int release_direct_block(struct inode *inode, int sectors_to_clear) {
 
 bool is_direct_block_sequential(struct inode *inode, int num_to_free_capped) {
 
-  ASSERT(10 > num_to_free_capped);
+  ASSERT(DIRECT_CNT >= num_to_free_capped);
 
   if (num_to_free_capped == 0)
     return false;
@@ -344,7 +593,7 @@ bool is_direct_block_sequential(struct inode *inode, int num_to_free_capped) {
     if (i == 0)
       continue;
 
-    if (first_sector + i != inode->data.direct_block_sectors[i])
+    if (first_sector + i * fs_block_sectors != inode->data.direct_block_sectors[i])
       return false;
   }
   return true;
@@ -361,22 +610,24 @@ int release_block(block_sector_t sector_to_release, int sectors_to_clear) {
   if (sectors_to_clear == 0)
     return 0;
 
-  uint32_t *mock_sector = malloc(BLOCK_SECTOR_SIZE);
+  uint32_t *mock_sector = malloc(FS_BLOCK_SIZE);
 
   if (mock_sector == NULL)
-    PANIC("int release_block(%d, %d) - malloc(%d) == NULLPTR\n", sector_to_release, sectors_to_clear, BLOCK_SECTOR_SIZE);
+    PANIC("int release_block(%d, %d) - malloc(%d) == NULLPTR\n", sector_to_release, sectors_to_clear, FS_BLOCK_SIZE);
 
-  block_read(fs_device, sector_to_release, mock_sector);
+  read_block(sector_to_release, mock_sector);
 
   int sectors_cleared = 0;
   block_sector_t sector;
-  while (sectors_cleared < 128 && sectors_to_clear > sectors_cleared) {
+  while ((size_t) sectors_cleared < PTRS_PER_BLOCK && sectors_to_clear > sectors_cleared) {
     // memcpy(&sector, mock_sector + sectors_cleared * sizeof(uint32_t), sizeof(uint32_t));
     sector = mock_sector[sectors_cleared];
-    free_map_release(sector, 1);
+    refcount_release(sector, 1);
     sectors_cleared++;
   }
 
+  free(mock_sector);
+
   return sectors_to_clear - sectors_cleared;
 }
 
@@ -385,22 +636,23 @@ int release_double_indirect_block(struct inode *inode, int sectors_to_clear) {
   if (sectors_to_clear == 0 || inode == NULL)
     return 0;
 
-  void *mock_sector = malloc(BLOCK_SECTOR_SIZE);
+  void *mock_sector = malloc(FS_BLOCK_SIZE);
 
   if (mock_sector == NULL)
-    PANIC("int release_double_indirect_block(%p, %d) - malloc(%d) == NULLPTR\n", inode, sectors_to_clear, BLOCK_SECTOR_SIZE);
+    PANIC("int release_double_indirect_block(%p, %d) - malloc(%d) == NULLPTR\n", inode, sectors_to_clear, FS_BLOCK_SIZE);
 
   block_sector_t sector;
   // int sectors_left_to_clear =
-  block_read(fs_device, inode->data.double_indirect_block, mock_sector);
+  read_block(inode->data.double_indirect_block, mock_sector);
 
   int i = 0;
-  int sectors_to_free = DIV_ROUND_UP(sectors_to_clear, 128);
+  int sectors_to_free = DIV_ROUND_UP(sectors_to_clear, PTRS_PER_BLOCK);
   for (; i < sectors_to_free; i++) {
     memcpy(&sector, mock_sector + i * sizeof(uint32_t), sizeof(uint32_t));
     sectors_to_clear = release_block(sector, sectors_to_clear);
     free_map_release(sector, 1);
   }
+  free(mock_sector);
   return sectors_to_clear;
 }
 
@@ -408,11 +660,27 @@ void inode_close(struct inode *inode) {
   if (inode == NULL)
     return;
 
+  if (tmpfs_owns(inode->sector)) {
+    tmpfs_close(inode);
+    return;
+  }
+  if (romfs_owns(inode->sector)) {
+    romfs_close(inode);
+    return;
+  }
+
   if (--inode->open_cnt == 0) {
+    // Cached pages are only valid while the inode is open.
+    cache_drop(inode);
+
+    lock_acquire(&tail_lock);
+    tail_flush(inode, true);
     list_remove(&inode->elem);
+    lock_release(&tail_lock);
+    free(inode->tail);
 
     if (inode->removed) {
-      int num_sectors_to_free = bytes_to_sectors(inode->data.length);
+      int num_sectors_to_free = inode->data.blocks_allocated;
 
       num_sectors_to_free = release_direct_block(inode, num_sectors_to_free);
 
@@ -424,57 +692,710 @@ void inode_close(struct inode *inode) {
 
       ASSERT(num_sectors_to_free == 0);
 
+      // A whole block each, so worth giving back.
+      free_map_release(inode->data.indirect_block_sector, 1);
+      free_map_release(inode->data.double_indirect_block, 1);
+      if (inode->data.flags & INODE_COMPRESSED)
+        free_map_release(inode->data.cluster_map, 1);
       free_map_release(inode->sector, 1);
     }
+    free(inode->cluster_map);
     free(inode);
   }
 }
 
-// Check this logic @@@
-block_sector_t inode_offset_to_sector(struct inode_disk *inode_d, off_t current_offset) {
+// Returns the first sector of the data block holding byte CURRENT_OFFSET
+// of INODE_D, or -1 if it has no such block.
+static block_sector_t inode_offset_to_block(struct inode_disk *inode_d, off_t current_offset) {
 
-  ASSERT(inode_d->sectors_allocated * 512 >= current_offset);
+  ASSERT((off_t) (inode_d->blocks_allocated * FS_BLOCK_SIZE) >= current_offset);
 
-  // printf("inode_offset_to_sector(%p, %d)\n", inode_d, current_offset);
-  int sector_count = current_offset / 512;
+  int sector_count = current_offset / FS_BLOCK_SIZE;
 
 
-  if (sector_count >= 0 && sector_count <= 9)
+  if (sector_count >= 0 && sector_count < DIRECT_CNT)
     return inode_d->direct_block_sectors[sector_count];
 
-  sector_count -= 10;
+  sector_count -= DIRECT_CNT;
 
-  uint32_t *mock_sector = malloc(BLOCK_SECTOR_SIZE);
-  if (sector_count >= 0 && sector_count <= 127) {
-    block_sector_t sector;
-    block_read(fs_device, inode_d->indirect_block_sector, mock_sector);
+  uint32_t *mock_sector = malloc(FS_BLOCK_SIZE);
+  block_sector_t sector = -1;
+  if (sector_count >= 0 && (size_t) sector_count < PTRS_PER_BLOCK) {
+    read_block(inode_d->indirect_block_sector, mock_sector);
     sector = mock_sector[sector_count];
-    // memcpy(&sector, mock_sector + sizeof(uint32_t) * (sector_count - 1), sizeof(uint32_t));
-    // printf("\nSector is: %d\n", sector);
     free(mock_sector);
     return sector;
   }
-  sector_count -= 128;
+  sector_count -= PTRS_PER_BLOCK;
 
-  if (sector_count >= 0 && sector_count <= 16383) { /* 128 * 128 */
-    // int indirect_sector = (sector_count - 1) / 128;
-    int indirect_sector = sector_count / 128;
-    block_sector_t sector;
-    block_read(fs_device, inode_d->double_indirect_block, mock_sector);
+  if (sector_count >= 0 && (size_t) sector_count < PTRS_PER_BLOCK * PTRS_PER_BLOCK) {
+    int indirect_sector = sector_count / PTRS_PER_BLOCK;
+    read_block(inode_d->double_indirect_block, mock_sector);
     sector = mock_sector[indirect_sector];
-    // memcpy(&sector, mock_sector + sizeof(uint32_t) * indirect_sector, sizeof(uint32_t));
-    block_read(fs_device, sector, mock_sector);
+    read_block(sector, mock_sector);
 
-    // int pos = (sector_count - 1) % BLOCK_SECTOR_SIZE;
-    int pos = sector_count % BLOCK_SECTOR_SIZE;
+    int pos = sector_count % PTRS_PER_BLOCK;
     sector = mock_sector[pos];
-    // memcpy(&sector, mock_sector + sizeof(uint32_t) * pos, sizeof(uint32_t));
+  }
+
+  free(mock_sector);
+  return sector;
+}
+
+// Returns the sector holding byte CURRENT_OFFSET of INODE_D, or -1 if it
+// has no such sector.
+block_sector_t inode_offset_to_sector(struct inode_disk *inode_d, off_t current_offset) {
+
+  block_sector_t block = inode_offset_to_block(inode_d, current_offset);
+
+  if (block == (block_sector_t) -1)
+    return block;
+  return block + current_offset % FS_BLOCK_SIZE / BLOCK_SECTOR_SIZE;
+}
+
+// Counts how many of the (at most MAX) sectors starting at CURRENT_OFFSET,
+// which must be sector aligned, sit next to each other on disk, storing
+// the first in *START.  Runs stop at the end of an index block, so each
+// block of pointers is read at most once.
+static int inode_sector_run(struct inode_disk *inode_d, off_t current_offset, int max, block_sector_t *start) {
+
+  ASSERT(current_offset % BLOCK_SECTOR_SIZE == 0);
+  ASSERT(max > 0);
+
+  int sector_count = current_offset / FS_BLOCK_SIZE;
+  int sector_ofs = current_offset % FS_BLOCK_SIZE / BLOCK_SECTOR_SIZE;
+  uint32_t *ptrs;
+  int idx, limit, run, i;
+  uint32_t *mock_sector = NULL;
+
+  if (sector_count < DIRECT_CNT) {
+    ptrs = inode_d->direct_block_sectors;
+    idx = sector_count;
+    limit = DIRECT_CNT;
+  } else if ((size_t) sector_count < DIRECT_CNT + PTRS_PER_BLOCK) {
+    mock_sector = malloc(FS_BLOCK_SIZE);
+    if (mock_sector == NULL) {
+      *start = inode_offset_to_sector(inode_d, current_offset);
+      return 1;
+    }
+    read_block(inode_d->indirect_block_sector, mock_sector);
+    ptrs = mock_sector;
+    idx = sector_count - DIRECT_CNT;
+    limit = PTRS_PER_BLOCK;
+  } else {
+    mock_sector = malloc(FS_BLOCK_SIZE);
+    if (mock_sector == NULL) {
+      *start = inode_offset_to_sector(inode_d, current_offset);
+      return 1;
+    }
+    sector_count -= DIRECT_CNT + PTRS_PER_BLOCK;
+    read_block(inode_d->double_indirect_block, mock_sector);
+    read_block(mock_sector[sector_count / PTRS_PER_BLOCK], mock_sector);
+    ptrs = mock_sector;
+    idx = sector_count % PTRS_PER_BLOCK;
+    limit = PTRS_PER_BLOCK;
+  }
+
+  // The rest of the first block, then every whole block that follows it.
+  *start = ptrs[idx] + sector_ofs;
+  run = fs_block_sectors - sector_ofs;
+  for (i = 1; run < max && idx + i < limit; i++) {
+    if (ptrs[idx + i] != ptrs[idx] + i * fs_block_sectors)
+      break;
+    run += fs_block_sectors;
+  }
+
+  free(mock_sector);
+  return run < max ? run : max;
+}
+
+// Sectors inode_defrag() copies per block_read_multiple() call.
+#define DEFRAG_COPY_SECTORS 64
+
+// Reads the first sectors of INODE_D's data blocks, in file order, into a
+// new array and returns it, or NULL if out of memory.
+block_sector_t *inode_collect_blocks(struct inode_disk *inode_d) {
+
+  int sectors = inode_d->blocks_allocated;
+  block_sector_t *list = malloc(sectors * sizeof *list);
+  uint32_t *mock_sector = malloc(FS_BLOCK_SIZE);
+  uint32_t *block = malloc(FS_BLOCK_SIZE);
+  int i = 0;
+  const int indirect_end = DIRECT_CNT + PTRS_PER_BLOCK;
+
+  if (list == NULL || mock_sector == NULL || block == NULL) {
+    free(list);
+    list = NULL;
+    goto done;
+  }
+
+  for (; i < sectors && i < DIRECT_CNT; i++)
+    list[i] = inode_d->direct_block_sectors[i];
+
+  if (i < sectors) {
+    read_block(inode_d->indirect_block_sector, mock_sector);
+    for (; i < sectors && i < indirect_end; i++)
+      list[i] = mock_sector[i - DIRECT_CNT];
+  }
+
+  if (i < sectors) {
+    read_block(inode_d->double_indirect_block, mock_sector);
+    for (; i < sectors; i++) {
+      int idx = i - indirect_end;
+      if (idx % PTRS_PER_BLOCK == 0)
+        read_block(mock_sector[idx / PTRS_PER_BLOCK], block);
+      list[i] = block[idx % PTRS_PER_BLOCK];
+    }
+  }
+
+ done:
+  free(block);
+  free(mock_sector);
+  return list;
+}
+
+// Points INODE_D's data blocks at the SECTORS blocks in LIST, rewriting
+// its index blocks and then the inode itself.  The index blocks stay where
+// they are, so any second-level blocks must already exist.
+static void inode_point_at_list(struct inode_disk *inode_d, const block_sector_t *list, int sectors) {
+
+  uint32_t *mock_sector = malloc(FS_BLOCK_SIZE);
+  uint32_t *block = malloc(FS_BLOCK_SIZE);
+  int i = 0;
+  const int ptrs = PTRS_PER_BLOCK;
+  const int indirect_end = DIRECT_CNT + ptrs;
+
+  if (mock_sector == NULL || block == NULL)
+    PANIC("inode_point_at_list - malloc(%d) == NULLPTR\n", FS_BLOCK_SIZE);
+
+  for (; i < sectors && i < DIRECT_CNT; i++)
+    inode_d->direct_block_sectors[i] = list[i];
+
+  if (i < sectors) {
+    memset(mock_sector, 0, FS_BLOCK_SIZE);
+    for (; i < sectors && i < indirect_end; i++)
+      mock_sector[i - DIRECT_CNT] = list[i];
+    write_block(inode_d->indirect_block_sector, mock_sector);
+  }
+
+  if (i < sectors) {
+    read_block(inode_d->double_indirect_block, mock_sector);
+    while (i < sectors) {
+      int idx = i - indirect_end;
+      memset(block, 0, FS_BLOCK_SIZE);
+      for (; i < sectors && i - indirect_end < idx + ptrs; i++)
+        block[(i - indirect_end) % ptrs] = list[i];
+      write_block(mock_sector[idx / ptrs], block);
+    }
+  }
+
+  block_write(fs_device, inode_d->sector, inode_d);
+  free(block);
+  free(mock_sector);
+}
+
+/* Moves INODE's data into one run of free sectors if it is
+   currently split across several, so that it can be read back
+   sequentially.  The data is copied before any pointer changes
+   and the old sectors are released only after the inode has
+   been rewritten, so readers of an open INODE see either the old
+   or the new copy, both intact.  Callers must keep other writers
+   out of the file system meanwhile.
+   Returns true if INODE was moved, false if it was already
+   contiguous or no large enough free run exists. */
+bool inode_defrag(struct inode *inode) {
+
+  struct inode_disk *inode_d = &inode->data;
+  int sectors = inode_d->blocks_allocated;
+  int copy_blocks = DEFRAG_COPY_SECTORS / fs_block_sectors;
+  block_sector_t *old, *new_list, start;
+  uint8_t *buffer;
+  int i, run;
+
+  if (sectors < 2)
+    return false;
+
+  // The copy is made from disk.
+  tail_sync(inode, inode_length(inode) + 1, true);
+
+  old = inode_collect_blocks(inode_d);
+  if (old == NULL)
+    return false;
+
+  for (i = 1; i < sectors; i++)
+    if (old[i] != old[i - 1] + fs_block_sectors)
+      break;
+  if (i == sectors) {
+    free(old);
+    return false;
+  }
+
+  // Moving a clone would give it a private copy of its data.
+  for (i = 0; i < sectors; i++)
+    if (refcount_is_shared(old[i])) {
+      free(old);
+      return false;
+    }
+
+  buffer = malloc(DEFRAG_COPY_SECTORS * BLOCK_SECTOR_SIZE);
+  new_list = malloc(sectors * sizeof *new_list);
+  if (buffer == NULL || new_list == NULL || !free_map_allocate(sectors, &start)) {
+    free(new_list);
+    free(buffer);
+    free(old);
+    return false;
+  }
+
+  // Copy each run of old blocks into place.
+  for (i = 0; i < sectors; i += run) {
+    for (run = 1; i + run < sectors && run < copy_blocks; run++)
+      if (old[i + run] != old[i] + run * fs_block_sectors)
+        break;
+    block_read_multiple(fs_device, old[i], run * fs_block_sectors, buffer);
+    block_write_multiple(fs_device, start + i * fs_block_sectors, run * fs_block_sectors, buffer);
+  }
+
+  for (i = 0; i < sectors; i++)
+    new_list[i] = start + i * fs_block_sectors;
+  inode_point_at_list(inode_d, new_list, sectors);
+
+  for (i = 0; i < sectors; i += run) {
+    for (run = 1; i + run < sectors; run++)
+      if (old[i + run] != old[i] + run * fs_block_sectors)
+        break;
+    free_map_release(old[i], run);
+  }
+
+  free(new_list);
+  free(buffer);
+  free(old);
+  return true;
+}
+
+/* Writes a new inode to SECTOR that holds the same data as SRC by
+   pointing at SRC's data sectors rather than copying them.  Only
+   the new inode's index blocks are allocated; each shared sector
+   is copied later, by whichever inode first writes to it.
+   Returns true if successful, false if either inode is not on the
+   file system device, memory runs out, or a sector is already shared too many times. */
+bool inode_clone(struct inode *src, block_sector_t sector) {
+
+  struct inode_disk *src_d = &src->data;
+  int sectors = src_d->blocks_allocated;
+  struct inode_disk *disk_inode;
+  block_sector_t *list = NULL;
+  int i;
+
+  ASSERT(!inode_is_dir(src));
+
+  if (!on_fs_device(src->sector) || !on_fs_device(sector))
+    return false;
+
+  // The clone shares what is on disk, so push out mmap writes and
+  // buffered appends first.
+  cache_flush(src);
+  tail_sync(src, inode_length(src) + 1, true);
+
+  if (sectors > 0) {
+    list = inode_collect_blocks(src_d);
+    if (list == NULL)
+      return false;
+  }
+
+  disk_inode = calloc(1, sizeof *disk_inode);
+  if (disk_inode == NULL) {
+    free(list);
+    return false;
+  }
+
+  for (i = 0; i < sectors; i++)
+    if (!refcount_share(list[i])) {
+      while (i-- > 0)
+        refcount_release(list[i], 1);
+      free(disk_inode);
+      free(list);
+      return false;
+    }
+
+  disk_inode->length = src_d->length;
+  disk_inode->sector = sector;
+  disk_inode->blocks_allocated = sectors;
+  disk_inode->is_dir = false;
+  disk_inode->magic = INODE_MAGIC;
+  disk_inode->block_size = FS_BLOCK_SIZE;
+  disk_inode->indirect_block_sector = get_individual_sector();
+  disk_inode->double_indirect_block = get_individual_sector();
+
+  // The cluster map is rewritten in place, so the clone needs its own.
+  if (src_d->flags & INODE_COMPRESSED) {
+    disk_inode->flags = INODE_COMPRESSED;
+    disk_inode->cluster_map = get_individual_sector();
+    block_write(fs_device, disk_inode->cluster_map, src->cluster_map);
+  }
 
+  // Second-level blocks of the double indirect block.
+  if ((size_t) sectors > DIRECT_CNT + PTRS_PER_BLOCK) {
+    uint32_t *mock_sector = calloc(1, FS_BLOCK_SIZE);
+    if (mock_sector == NULL)
+      PANIC("inode_clone - malloc(%d) == NULLPTR\n", FS_BLOCK_SIZE);
+    for (i = 0; (size_t) i < DIV_ROUND_UP(sectors - DIRECT_CNT - PTRS_PER_BLOCK, PTRS_PER_BLOCK); i++)
+      mock_sector[i] = get_individual_sector();
+    write_block(disk_inode->double_indirect_block, mock_sector);
     free(mock_sector);
-    return sector;
   }
 
-  return -1;
+  inode_point_at_list(disk_inode, list, sectors);
+
+  free(disk_inode);
+  free(list);
+  return true;
+}
+
+// Points the data block holding byte CURRENT_OFFSET of INODE_D at the
+// block starting at SECTOR, writing back whichever block holds the pointer.
+static void inode_set_offset_block(struct inode_disk *inode_d, off_t current_offset, block_sector_t sector) {
+
+  int sector_count = current_offset / FS_BLOCK_SIZE;
+  uint32_t *mock_sector;
+
+  if (sector_count < DIRECT_CNT) {
+    inode_d->direct_block_sectors[sector_count] = sector;
+    block_write(fs_device, inode_d->sector, inode_d);
+    return;
+  }
+
+  mock_sector = malloc(FS_BLOCK_SIZE);
+  if (mock_sector == NULL)
+    PANIC("inode_set_offset_block - malloc(%d) == NULLPTR\n", FS_BLOCK_SIZE);
+
+  sector_count -= DIRECT_CNT;
+  if ((size_t) sector_count < PTRS_PER_BLOCK) {
+    read_block(inode_d->indirect_block_sector, mock_sector);
+    mock_sector[sector_count] = sector;
+    write_block(inode_d->indirect_block_sector, mock_sector);
+  } else {
+    block_sector_t block;
+    sector_count -= PTRS_PER_BLOCK;
+    read_block(inode_d->double_indirect_block, mock_sector);
+    block = mock_sector[sector_count / PTRS_PER_BLOCK];
+    read_block(block, mock_sector);
+    mock_sector[sector_count % PTRS_PER_BLOCK] = sector;
+    write_block(block, mock_sector);
+  }
+  free(mock_sector);
+}
+
+// Gives INODE a private copy of the shared block that holds byte
+// CURRENT_OFFSET, where OLD is the sector holding that byte, and returns
+// the corresponding sector of the copy.
+static block_sector_t inode_unshare_sector(struct inode *inode, off_t current_offset, block_sector_t old) {
+
+  block_sector_t sector_ofs = current_offset % FS_BLOCK_SIZE / BLOCK_SECTOR_SIZE;
+  block_sector_t copy = get_individual_sector();
+  void *bounce = malloc(FS_BLOCK_SIZE);
+
+  if (bounce == NULL)
+    PANIC("inode_unshare_sector - malloc(%d) == NULLPTR\n", FS_BLOCK_SIZE);
+
+  old -= sector_ofs;
+  read_block(old, bounce);
+  write_block(copy, bounce);
+  free(bounce);
+
+  inode_set_offset_block(&inode->data, current_offset, copy);
+  refcount_release(old, 1);
+  return copy + sector_ofs;
+}
+
+// Compressed files keep their data in clusters of CLUSTER_SECTORS sectors.
+// Each cluster still owns all of its sectors, but only the first few hold
+// data, so compressible files move fewer sectors per byte. A map sector
+// records, one byte per cluster, how many sectors each cluster uses.
+#define CLUSTER_SECTORS 8
+#define CLUSTER_SIZE (CLUSTER_SECTORS * BLOCK_SECTOR_SIZE)
+#define CLUSTER_CNT BLOCK_SECTOR_SIZE     /* clusters one map sector covers */
+#define CLUSTER_ZERO 0                    /* cluster is all zeros, not stored */
+#define CLUSTER_RAW 0xff                  /* cluster is stored uncompressed */
+
+// Returns the number of bytes of file data in the cluster of INODE that
+// starts at CLUSTER_OFS.
+static int cluster_bytes(const struct inode *inode, off_t cluster_ofs) {
+  off_t left = inode_length(inode) - cluster_ofs;
+  return left < CLUSTER_SIZE ? left : CLUSTER_SIZE;
+}
+
+// Reads or writes the first CNT sectors of the cluster of INODE that starts
+// at CLUSTER_OFS, a run of adjacent sectors at a time. Shared sectors are
+// copied before they are written.
+static void cluster_io(struct inode *inode, off_t cluster_ofs, int cnt, uint8_t *buffer, bool write) {
+
+  block_sector_t start;
+  int i, run;
+
+  for (i = 0; i < cnt; i += run) {
+    off_t ofs = cluster_ofs + i * BLOCK_SECTOR_SIZE;
+
+    if (write) {
+      start = inode_offset_to_sector(&inode->data, ofs);
+      if (refcount_is_shared(start))
+        inode_unshare_sector(inode, ofs, start);
+    }
+
+    run = inode_sector_run(&inode->data, ofs, cnt - i, &start);
+    if (write) {
+      run = refcount_first_shared(start, run);
+      block_write_multiple(fs_device, start, run, buffer + i * BLOCK_SECTOR_SIZE);
+    } else {
+      block_read_multiple(fs_device, start, run, buffer + i * BLOCK_SECTOR_SIZE);
+    }
+  }
+}
+
+// Reads the cluster of compressed INODE that starts at CLUSTER_OFS into
+// CLUSTER, which holds CLUSTER_SIZE bytes, zeroing whatever lies past the
+// end of file. TEMP is CLUSTER_SIZE bytes of scratch space. Returns false
+// if the cluster does not decompress.
+static bool cluster_read(struct inode *inode, off_t cluster_ofs, uint8_t *cluster, uint8_t *temp) {
+
+  int bytes = cluster_bytes(inode, cluster_ofs);
+  int used = inode->cluster_map[cluster_ofs / CLUSTER_SIZE];
+
+  if (used == CLUSTER_ZERO) {
+    memset(cluster, 0, CLUSTER_SIZE);
+    return true;
+  }
+  if (used == CLUSTER_RAW) {
+    cluster_io(inode, cluster_ofs, DIV_ROUND_UP(bytes, BLOCK_SECTOR_SIZE), cluster, false);
+    memset(cluster + bytes, 0, CLUSTER_SIZE - bytes);
+    return true;
+  }
+
+  memset(cluster + bytes, 0, CLUSTER_SIZE - bytes);
+  cluster_io(inode, cluster_ofs, used, temp, false);
+  return lz_decompress(temp, used * BLOCK_SECTOR_SIZE, cluster, bytes) == (size_t) bytes;
+}
+
+// Stores the file data in CLUSTER as the cluster of INODE that starts at
+// CLUSTER_OFS, compressed if that saves at least one sector, and records
+// how it was stored in INODE's cluster map (but does not write the map).
+// TEMP is CLUSTER_SIZE bytes and WORK LZ_WORK_SIZE bytes of scratch space.
+static void cluster_write(struct inode *inode, off_t cluster_ofs, uint8_t *cluster, uint8_t *temp, void *work) {
+
+  int bytes = cluster_bytes(inode, cluster_ofs);
+  int sectors = DIV_ROUND_UP(bytes, BLOCK_SECTOR_SIZE);
+  int used, i;
+  size_t packed;
+
+  for (i = 0; i < bytes && cluster[i] == 0; i++)
+    continue;
+
+  if (i == bytes) {
+    used = CLUSTER_ZERO;
+  } else if ((packed = lz_compress(cluster, bytes, temp, (sectors - 1) * BLOCK_SECTOR_SIZE, work)) > 0) {
+    used = DIV_ROUND_UP(packed, BLOCK_SECTOR_SIZE);
+    memset(temp + packed, 0, used * BLOCK_SECTOR_SIZE - packed);
+    cluster_io(inode, cluster_ofs, used, temp, true);
+  } else {
+    used = CLUSTER_RAW;
+    memset(cluster + bytes, 0, CLUSTER_SIZE - bytes);
+    cluster_io(inode, cluster_ofs, sectors, cluster, true);
+  }
+  inode->cluster_map[cluster_ofs / CLUSTER_SIZE] = used;
+}
+
+// inode_read_at() for compressed files: decompresses each cluster the
+// read touches.
+static off_t inode_read_compressed(struct inode *inode, uint8_t *buffer, off_t size, off_t offset) {
+
+  uint8_t *cluster = malloc(CLUSTER_SIZE);
+  uint8_t *temp = malloc(CLUSTER_SIZE);
+  off_t bytes_read = 0;
+
+  while (cluster != NULL && temp != NULL && size > 0) {
+    int cluster_ofs = offset % CLUSTER_SIZE;
+    off_t inode_left = inode_length(inode) - offset;
+    int cluster_left = CLUSTER_SIZE - cluster_ofs;
+    int min_left = inode_left < cluster_left ? inode_left : cluster_left;
+    int chunk_size = size < min_left ? size : min_left;
+
+    if (chunk_size <= 0 || !cluster_read(inode, offset - cluster_ofs, cluster, temp))
+      break;
+    memcpy(buffer + bytes_read, cluster + cluster_ofs, chunk_size);
+
+    size -= chunk_size;
+    offset += chunk_size;
+    bytes_read += chunk_size;
+  }
+
+  free(temp);
+  free(cluster);
+  return bytes_read;
+}
+
+// inode_write_at() for compressed files: each cluster the write touches is
+// read back if the write covers only part of it, then compressed anew.
+static off_t inode_write_compressed(struct inode *inode, const uint8_t *buffer, off_t size, off_t offset) {
+
+  uint8_t *cluster = malloc(CLUSTER_SIZE);
+  uint8_t *temp = malloc(CLUSTER_SIZE);
+  void *work = malloc(LZ_WORK_SIZE);
+  off_t bytes_written = 0;
+
+  while (cluster != NULL && temp != NULL && work != NULL && size > 0) {
+    int cluster_ofs = offset % CLUSTER_SIZE;
+    off_t inode_left = inode_length(inode) - offset;
+    int cluster_left = CLUSTER_SIZE - cluster_ofs;
+    int min_left = inode_left < cluster_left ? inode_left : cluster_left;
+    int chunk_size = size < min_left ? size : min_left;
+
+    if (chunk_size <= 0)
+      break;
+    if (chunk_size < cluster_bytes(inode, offset - cluster_ofs)
+        && !cluster_read(inode, offset - cluster_ofs, cluster, temp))
+      break;
+    memcpy(cluster + cluster_ofs, buffer + bytes_written, chunk_size);
+    cluster_write(inode, offset - cluster_ofs, cluster, temp, work);
+
+    size -= chunk_size;
+    offset += chunk_size;
+    bytes_written += chunk_size;
+  }
+
+  if (bytes_written > 0)
+    block_write(fs_device, inode->data.cluster_map, inode->cluster_map);
+  free(work);
+  free(temp);
+  free(cluster);
+  return bytes_written;
+}
+
+// Grows compressed INODE to LENGTH bytes. Clusters past the old end of
+// file are already marked as zeros in the map, but a partial last cluster
+// was encoded at its old size, so it is re-encoded, zero padded, at the new
+// one. Returns false if LENGTH is more than the cluster map covers or
+// memory runs out.
+static bool inode_grow_compressed(struct inode *inode, off_t length) {
+
+  off_t last = inode_length(inode) - inode_length(inode) % CLUSTER_SIZE;
+  uint8_t *cluster = NULL, *temp = NULL;
+  void *work = NULL;
+  bool success = false;
+
+  if (length > CLUSTER_CNT * CLUSTER_SIZE)
+    return false;
+  if (last == inode_length(inode)) {
+    inode->data.length = length;
+    return true;
+  }
+
+  cluster = malloc(CLUSTER_SIZE);
+  temp = malloc(CLUSTER_SIZE);
+  work = malloc(LZ_WORK_SIZE);
+  if (cluster != NULL && temp != NULL && work != NULL && cluster_read(inode, last, cluster, temp)) {
+    inode->data.length = length;
+    cluster_write(inode, last, cluster, temp, work);
+    block_write(fs_device, inode->data.cluster_map, inode->cluster_map);
+    success = true;
+  }
+
+  free(work);
+  free(temp);
+  free(cluster);
+  return success;
+}
+
+/* Extends INODE, whose blocks must already be allocated, to LENGTH
+   bytes ahead of a write at OFFSET.  Bytes between the old end of
+   file and OFFSET read back as zeros.  Returns false if INODE
+   cannot grow that far. */
+static bool inode_grow(struct inode *inode, off_t offset, off_t length) {
+
+  off_t old_length = inode_length(inode);
+
+  if (inode->data.flags & INODE_COMPRESSED) {
+    if (!inode_grow_compressed(inode, length))
+      return false;
+  } else {
+    inode->data.length = length;
+  }
+  block_write(fs_device, inode->sector, &inode->data);
+  inode->data_dirty = false;
+
+  // Whatever was past the old end of file is not necessarily zero.
+  if (offset > old_length && !(inode->data.flags & INODE_COMPRESSED)) {
+    static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+    off_t ofs;
+
+    for (ofs = old_length; ofs < offset; ) {
+      off_t chunk = offset - ofs < BLOCK_SECTOR_SIZE ? offset - ofs : BLOCK_SECTOR_SIZE;
+      ofs += inode_write_at(inode, zeros, chunk, ofs);
+    }
+  }
+  return true;
+}
+
+/* Turns on compression for INODE, re-encoding its data in place a
+   cluster at a time.  Returns false if INODE is a directory, is
+   not on the file system device, is already compressed, is open for execution, is
+   longer than one cluster map covers, or memory or disk space
+   runs out. */
+bool inode_compress(struct inode *inode) {
+
+  off_t length = inode_length(inode);
+  uint8_t *map = calloc(1, BLOCK_SECTOR_SIZE);
+  uint8_t *cluster = malloc(CLUSTER_SIZE);
+  uint8_t *temp = malloc(CLUSTER_SIZE);
+  void *work = malloc(LZ_WORK_SIZE);
+  block_sector_t map_sector;
+  bool success = false;
+  off_t ofs;
+
+  if (inode_is_dir(inode) || !on_fs_device(inode->sector)
+      || (inode->data.flags & INODE_COMPRESSED) || inode->deny_write_cnt > 0 || length > CLUSTER_CNT * CLUSTER_SIZE
+      || map == NULL || cluster == NULL || temp == NULL || work == NULL
+      || !free_map_allocate(1, &map_sector))
+    goto done;
+
+  // Data written through mmap() or appended must reach the disk before it is
+  // re-encoded.
+  cache_flush(inode);
+  tail_sync(inode, length + 1, true);
+
+  inode->cluster_map = map;
+  for (ofs = 0; ofs < length; ofs += CLUSTER_SIZE) {
+    inode_read_at(inode, cluster, cluster_bytes(inode, ofs), ofs);
+    cluster_write(inode, ofs, cluster, temp, work);
+  }
+  map = NULL;
+
+  inode->data.flags |= INODE_COMPRESSED;
+  inode->data.cluster_map = map_sector;
+  block_write(fs_device, map_sector, inode->cluster_map);
+  block_write(fs_device, inode->sector, &inode->data);
+  success = true;
+
+ done:
+  free(work);
+  free(temp);
+  free(cluster);
+  free(map);
+  return success;
+}
+
+/* Returns the file system block size recorded in the inode at
+   SECTOR, reading it straight from disk.  Used at mount time,
+   before anything else about the file system is known. */
+size_t inode_read_block_size(block_sector_t sector) {
+
+  struct inode_disk *disk_inode = malloc(sizeof *disk_inode);
+  size_t block_size;
+
+  if (disk_inode == NULL)
+    PANIC("inode_read_block_size - malloc(%d) == NULLPTR\n", BLOCK_SECTOR_SIZE);
+  block_read(fs_device, sector, disk_inode);
+  block_size = disk_inode->block_size != 0 ? disk_inode->block_size : BLOCK_SECTOR_SIZE;
+  free(disk_inode);
+  return block_size;
 }
 
 /* ENDIFENDIFENDIFENDIFENDIFENDIFENDIFENDIFENDIF */
@@ -483,13 +1404,13 @@ block_sector_t inode_offset_to_sector(struct inode_disk *inode_d, off_t current_
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  IS_DIR marks the inode as holding a directory.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 
 #ifndef FILESYS
 
-bool inode_create (block_sector_t sector, off_t length) {
+bool inode_create (block_sector_t sector, off_t length, bool is_dir) {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
 
@@ -504,6 +1425,7 @@ bool inode_create (block_sector_t sector, off_t length) {
     {
       size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
+      disk_inode->is_dir = is_dir;
       disk_inode->magic = INODE_MAGIC;
       if (free_map_allocate (sectors, &disk_inode->start))
         {
@@ -532,6 +1454,17 @@ struct inode *inode_open (block_sector_t sector) {
   struct list_elem *e;
   struct inode *inode;
 
+#ifdef FILESYS
+  if (tmpfs_owns (sector))
+    return tmpfs_open (sector);
+  if (romfs_owns (sector))
+    return romfs_open (sector);
+#endif
+
+#ifdef FILESYS
+  lock_acquire (&tail_lock);
+#endif
+
   /* Check whether this inode is already open. */
   for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
        e = list_next (e))
@@ -540,14 +1473,14 @@ struct inode *inode_open (block_sector_t sector) {
       if (inode->sector == sector)
         {
           inode_reopen (inode);
-          return inode;
+          goto done;
         }
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    goto done;
 
   /* Initialize. */
   list_push_front (&open_inodes, &inode->elem);
@@ -555,7 +1488,31 @@ struct inode *inode_open (block_sector_t sector) {
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->cluster_map = NULL;
+  inode->tail = NULL;
+  inode->tail_ofs = -1;
+  inode->tail_dirty = false;
+  inode->data_dirty = false;
   block_read (fs_device, inode->sector, &inode->data);
+#ifdef FILESYS
+  if (inode->data.flags & INODE_COMPRESSED)
+    {
+      inode->cluster_map = malloc (BLOCK_SECTOR_SIZE);
+      if (inode->cluster_map == NULL)
+        {
+          list_remove (&inode->elem);
+          free (inode);
+          inode = NULL;
+          goto done;
+        }
+      block_read (fs_device, inode->data.cluster_map, inode->cluster_map);
+    }
+#endif
+
+ done:
+#ifdef FILESYS
+  lock_release (&tail_lock);
+#endif
   return inode;
 }
 
@@ -625,6 +1582,19 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
 
+#ifdef FILESYS
+  if (tmpfs_owns(inode->sector))
+    return tmpfs_read_at(inode, buffer, size, offset);
+  if (romfs_owns(inode->sector))
+    return romfs_read_at(inode, buffer, size, offset);
+
+  // The disk copy of a buffered tail sector may be stale.
+  tail_sync(inode, offset + size, false);
+
+  if (inode->data.flags & INODE_COMPRESSED)
+    return inode_read_compressed(inode, buffer, size, offset);
+#endif
+
   while (size > 0) {
 
 #ifdef FILESYS
@@ -643,6 +1613,15 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
     if (chunk_size <= 0)
       break;
 
+#ifdef FILESYS
+    // Several whole sectors left: read as many as lie together in one go.
+    if (sector_ofs == 0 && size >= 2 * BLOCK_SECTOR_SIZE && inode_left >= 2 * BLOCK_SECTOR_SIZE) {
+      int whole = (size < inode_left ? size : inode_left) / BLOCK_SECTOR_SIZE;
+      int run = inode_sector_run(&inode->data, offset, whole, &sector_idx);
+      chunk_size = run * BLOCK_SECTOR_SIZE;
+      block_read_multiple(fs_device, sector_idx, run, buffer + bytes_read);
+    } else
+#endif
     if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE) {
       block_read(fs_device, sector_idx, buffer + bytes_read);
     } else {
@@ -674,31 +1653,61 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size, off_t
     return 0;
 
 #ifdef FILESYS
-  int sectors_requested_access = DIV_ROUND_UP(size + offset, BLOCK_SECTOR_SIZE);
-  if (sectors_requested_access > inode->data.sectors_allocated) {
-      int sectors_to_create = sectors_requested_access - inode->data.sectors_allocated;
+  if (tmpfs_owns(inode->sector))
+    return tmpfs_write_at(inode, buffer, size, offset);
+  if (romfs_owns(inode->sector))
+    return 0;
+
+  if (size <= 0)
+    return 0;
+
+  // A small append goes into the tail buffer. Anything else has to see,
+  // and may change, the sector the buffer holds.
+  bool append = (offset == (off_t) inode->data.length && size <= TAIL_APPEND_MAX
+                 && !inode_is_dir(inode) && !(inode->data.flags & INODE_COMPRESSED));
+  if (!append)
+    tail_sync(inode, offset + size, true);
+
+  size_t sectors_requested_access = bytes_to_blocks(size + offset);
+  if (sectors_requested_access > inode->data.blocks_allocated) {
+      int sectors_to_create = sectors_requested_access - inode->data.blocks_allocated;
 
-      if (sectors_to_create > 0 && inode->data.sectors_allocated < 10)
+      if (sectors_to_create > 0 && inode->data.blocks_allocated < DIRECT_CNT)
         sectors_to_create = extend_inode_direct(&inode->data, sectors_to_create, true);
 
-      if (sectors_to_create > 0 && inode->data.sectors_allocated >= 10 && inode->data.sectors_allocated < 138)
+      if (sectors_to_create > 0 && inode->data.blocks_allocated >= DIRECT_CNT
+          && inode->data.blocks_allocated < DIRECT_CNT + PTRS_PER_BLOCK)
         sectors_to_create = extend_inode_indirect(&inode->data, sectors_to_create);
 
-      if (sectors_to_create > 0 && inode->data.sectors_allocated >= 138 && inode->data.sectors_allocated < 16552)
+      if (sectors_to_create > 0 && inode->data.blocks_allocated >= DIRECT_CNT + PTRS_PER_BLOCK
+          && inode->data.blocks_allocated < max_blocks())
         sectors_to_create = extend_inode_dbl_indirect(&inode->data, sectors_to_create);
 
       if (sectors_to_create > 0) {
-        printf("You cannot grow your file past 8,459,264 bytes\n");
+        printf("You cannot grow your file past %llu bytes\n",
+               (unsigned long long) max_blocks() * FS_BLOCK_SIZE);
         return 0;
       }
+      inode->data_dirty = true;
   }
+
+  if (append && tail_append(inode, buffer, size))
+    return size;
+
+  if (offset + size > inode_length(inode) && !inode_grow(inode, offset, offset + size))
+    return 0;
+
+  if (inode->data.flags & INODE_COMPRESSED)
+    return inode_write_compressed(inode, buffer, size, offset);
 #endif
 
   while (size > 0) {
       /* Sector to write, starting byte offset within sector. */
 #ifdef FILESYS
       block_sector_t sector_idx = inode_offset_to_sector(&inode->data, offset);
-      // printf("sector_idx: %d\n", sector_idx);
+      // Copy on write: a sector shared with a clone gets copied first.
+      if (refcount_is_shared(sector_idx))
+        sector_idx = inode_unshare_sector(inode, offset, sector_idx);
 #else
       block_sector_t sector_idx = byte_to_sector (inode, offset);
 #endif
@@ -714,6 +1723,20 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size, off_t
       if (chunk_size <= 0)
         break;
 
+#ifdef FILESYS
+      if (sector_ofs == 0 && size >= 2 * BLOCK_SECTOR_SIZE
+          && inode_left >= 2 * BLOCK_SECTOR_SIZE)
+        {
+          /* Write a run of whole sectors directly to disk. */
+          int whole = (size < inode_left ? size : inode_left) / BLOCK_SECTOR_SIZE;
+          int run = inode_sector_run (&inode->data, offset, whole, &sector_idx);
+          run = refcount_first_shared (sector_idx, run);
+          chunk_size = run * BLOCK_SECTOR_SIZE;
+          block_write_multiple (fs_device, sector_idx, run,
+                                buffer + bytes_written);
+        }
+      else
+#endif
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
           /* Write full sector directly to disk. */
@@ -776,3 +1799,18 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Returns true if INODE holds a directory. */
+bool
+inode_is_dir (const struct inode *inode)
+{
+  return inode->data.is_dir != 0;
+}
+
+/* Returns true if INODE has been removed, that is, it will be
+   deleted when its last opener closes it. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
@@ -20,17 +20,26 @@ struct inode_disk {
   uint32_t double_indirect_block;         /* dindirect blocks */
   unsigned magic;                         /* magic - detect overflow */
   block_sector_t sector;                  /* which disk sector is this stored at? */
-  block_sector_t sectors_allocated;       /* number of sectors which this inode hodls (meme) */
-  uint32_t unused[112];                   /* pad to fit struct */
+  block_sector_t blocks_allocated;        /* number of data blocks this inode holds */
+  uint32_t is_dir;                        /* nonzero if this inode holds a directory */
+  uint32_t flags;                         /* INODE_* flags */
+  block_sector_t cluster_map;             /* sectors used per cluster, if compressed */
+  uint32_t block_size;                    /* file system block size, or 0 for
+                                             BLOCK_SECTOR_SIZE (older disks) */
+  uint32_t unused[108];                   /* pad to fit struct */
 };
 
+/* Flags for inode_disk.flags. */
+#define INODE_COMPRESSED 0x1              /* data stored in compressed clusters */
+
 #else
 
 struct inode_disk {
     block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t is_dir;                    /* Nonzero if a directory. */
+    uint32_t unused[124];               /* Not used. */
 };
 
 #endif
@@ -42,6 +51,13 @@ struct inode {
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    uint8_t *cluster_map;               /* Sectors used per cluster, if
+                                           compressed. */
+    uint8_t *tail;                      /* Sector being appended to, or
+                                           null; see inode.c. */
+    off_t tail_ofs;                     /* File offset of TAIL, or -1. */
+    bool tail_dirty;                    /* TAIL not yet written? */
+    bool data_dirty;                    /* DATA not yet written? */
     struct inode_disk data;             /* Inode content. */
 };
 
@@ -59,10 +75,16 @@ int release_indirect_block(struct inode *, int);
 int release_double_indirect_block(struct inode *, int);
 
 block_sector_t inode_offset_to_sector(struct inode_disk *, off_t);
+block_sector_t *inode_collect_blocks(struct inode_disk *);
+size_t inode_read_block_size(block_sector_t);
+void inode_flush_all(void);
+bool inode_defrag(struct inode *);
+bool inode_clone(struct inode *, block_sector_t);
+bool inode_compress(struct inode *);
 #endif
 
 void inode_init (void);
-bool inode_create (block_sector_t, off_t);
+bool inode_create (block_sector_t, off_t, bool is_dir);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
@@ -73,5 +95,7 @@ off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+bool inode_is_dir (const struct inode *);
+bool inode_is_removed (const struct inode *);
 
 #endif /* filesys/inode.h */
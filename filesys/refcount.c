@@ -0,0 +1,178 @@
+/* Reference counts for data blocks shared between inodes by
+   filesys_clone().
+
+   For each block we count the inodes that point to it beyond
+   the first, so the usual unshared block has a count of 0 and
+   nothing needs tracking until a file is cloned.  The counts are
+   not stored on disk: refcount_scan() rebuilds them at mount
+   time from the inodes themselves, so a clone's sharing survives
+   a reboot without any change to the disk format. */
+
+#include "filesys/refcount.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include "filesys/directory.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+
+/* Largest count a block can hold. */
+#define REFCOUNT_MAX UINT8_MAX
+
+static uint8_t *extra_refs;     /* Extra references, one per block. */
+
+/* Returns the index in extra_refs of the block holding SECTOR. */
+static inline size_t
+block_of (block_sector_t sector)
+{
+  return sector / fs_block_sectors;
+}
+
+static void scan_inode (struct inode *, struct bitmap *seen_data,
+                        struct bitmap *seen_inodes);
+
+/* Initializes the reference counts, with no block shared. */
+void
+refcount_init (void)
+{
+  extra_refs = calloc (block_size (fs_device) / fs_block_sectors,
+                       sizeof *extra_refs);
+  if (extra_refs == NULL)
+    PANIC ("refcount table creation failed--file system device is too large");
+}
+
+/* Rebuilds the reference counts by walking every inode reachable
+   from the root directory and counting each data block every
+   time it is seen after the first. */
+void
+refcount_scan (void)
+{
+  struct bitmap *seen_data = bitmap_create (block_size (fs_device)
+                                            / fs_block_sectors);
+  struct bitmap *seen_inodes = bitmap_create (block_size (fs_device));
+  struct inode *root;
+
+  if (seen_data == NULL || seen_inodes == NULL)
+    PANIC ("can't scan for shared sectors");
+
+  root = inode_open (ROOT_DIR_SECTOR);
+  if (root == NULL)
+    PANIC ("can't open root directory");
+  scan_inode (root, seen_data, seen_inodes);
+  inode_close (root);
+
+  bitmap_destroy (seen_inodes);
+  bitmap_destroy (seen_data);
+}
+
+/* Counts INODE's data blocks and, if it is a directory, those of
+   everything in it. */
+static void
+scan_inode (struct inode *inode, struct bitmap *seen_data,
+            struct bitmap *seen_inodes)
+{
+  block_sector_t inumber = inode_get_inumber (inode);
+  block_sector_t *sectors;
+
+  if (bitmap_test (seen_inodes, inumber))
+    return;
+  bitmap_mark (seen_inodes, inumber);
+
+  sectors = inode_collect_blocks (&inode->data);
+  if (sectors != NULL)
+    {
+      size_t i;
+
+      for (i = 0; i < inode->data.blocks_allocated; i++)
+        {
+          size_t block = block_of (sectors[i]);
+
+          if (!bitmap_test (seen_data, block))
+            bitmap_mark (seen_data, block);
+          else if (extra_refs[block] < REFCOUNT_MAX)
+            extra_refs[block]++;
+        }
+      free (sectors);
+    }
+
+  if (inode_is_dir (inode))
+    {
+      struct dir *dir = dir_open (inode_reopen (inode));
+      char name[NAME_MAX + 1];
+
+      if (dir == NULL)
+        return;
+      while (dir_readdir (dir, name))
+        {
+          struct inode *child;
+          if (dir_lookup (dir, name, &child))
+            {
+              scan_inode (child, seen_data, seen_inodes);
+              inode_close (child);
+            }
+        }
+      dir_close (dir);
+    }
+}
+
+/* Returns true if more than one inode points to the block
+   holding SECTOR. */
+bool
+refcount_is_shared (block_sector_t sector)
+{
+  return extra_refs[block_of (sector)] > 0;
+}
+
+/* Returns the offset of the first sector among the CNT starting
+   at SECTOR that lies in a shared block, or CNT if none does. */
+size_t
+refcount_first_shared (block_sector_t sector, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (extra_refs[block_of (sector + i)] > 0)
+      break;
+  return i;
+}
+
+/* Records one more inode pointing to the block that starts at
+   SECTOR.  Returns false, without changing anything, if its count
+   is already at its maximum. */
+bool
+refcount_share (block_sector_t sector)
+{
+  size_t block = block_of (sector);
+
+  if (extra_refs[block] == REFCOUNT_MAX)
+    return false;
+  extra_refs[block]++;
+  return true;
+}
+
+/* Drops one reference to each of the CNT consecutive data blocks
+   starting with the one at SECTOR, returning the ones nobody else
+   points to to the free map. */
+void
+refcount_release (block_sector_t sector, size_t cnt)
+{
+  size_t block = block_of (sector);
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (extra_refs[block + i] > 0)
+      break;
+  if (i == cnt)
+    {
+      free_map_release (sector, cnt);
+      return;
+    }
+
+  for (i = 0; i < cnt; i++)
+    if (extra_refs[block + i] > 0)
+      extra_refs[block + i]--;
+    else
+      free_map_release ((block + i) * fs_block_sectors, 1);
+}
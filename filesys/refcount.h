@@ -0,0 +1,16 @@
+#ifndef FILESYS_REFCOUNT_H
+#define FILESYS_REFCOUNT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+void refcount_init (void);
+void refcount_scan (void);
+
+bool refcount_is_shared (block_sector_t);
+size_t refcount_first_shared (block_sector_t, size_t cnt);
+bool refcount_share (block_sector_t);
+void refcount_release (block_sector_t, size_t cnt);
+
+#endif /* filesys/refcount.h */
@@ -0,0 +1,345 @@
+#include "filesys/romfs.h"
+#include <debug.h>
+#include <lz.h>
+#include <round.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Image header, in sector 0. */
+struct romfs_super
+  {
+    uint32_t magic;                     /* ROMFS_MAGIC. */
+    uint32_t file_cnt;                  /* Number of directory entries. */
+    uint32_t cluster_cnt;               /* Number of clusters. */
+    uint32_t dir_ofs;                   /* Byte offset of directory. */
+    uint32_t cluster_ofs;               /* Byte offset of cluster table. */
+    uint32_t size;                      /* Image size in bytes. */
+  };
+
+/* A file. */
+struct romfs_entry
+  {
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    uint8_t unused;                     /* Padding. */
+    uint32_t size;                      /* File size in bytes. */
+    uint32_t first_cluster;             /* Index of first cluster. */
+  };
+
+/* Where a cluster of file data is stored. */
+struct romfs_cluster
+  {
+    uint32_t ofs;                       /* Byte offset in the image. */
+    uint32_t size;                      /* Bytes stored; equal to the
+                                           cluster's length if stored
+                                           uncompressed. */
+  };
+
+static struct block *device;            /* Device holding the image,
+                                           or null if none. */
+static struct romfs_super super;        /* Image header. */
+static struct romfs_entry *entries;     /* Directory, sorted by name. */
+static struct romfs_cluster *clusters;  /* Cluster table. */
+static struct inode **inodes;           /* Each file's inode while it
+                                           is open, otherwise null. */
+static struct lock romfs_lock;          /* Protects INODES. */
+
+static bool check_image (void);
+static void *read_range (uint32_t ofs, size_t size, void **bufferp);
+static bool read_cluster (uint32_t idx, uint8_t *dst, size_t length);
+
+/* Mounts the image on the scratch device, if it holds one. */
+void
+romfs_init (void)
+{
+  struct romfs_super *s;
+  void *entry_buf = NULL, *cluster_buf = NULL;
+  const void *p;
+
+  lock_init (&romfs_lock);
+
+  device = block_get_role (BLOCK_SCRATCH);
+  if (device == NULL)
+    return;
+
+  s = malloc (BLOCK_SECTOR_SIZE);
+  if (s == NULL)
+    PANIC ("romfs: out of memory");
+  block_read (device, 0, s);
+  super = *s;
+  free (s);
+  if (super.magic != ROMFS_MAGIC)
+    {
+      /* Not an image: probably a tar archive to extract. */
+      device = NULL;
+      return;
+    }
+
+  if (super.size > block_size (device) * (uint64_t) BLOCK_SECTOR_SIZE
+      || super.dir_ofs > super.size
+      || super.file_cnt > (super.size - super.dir_ofs) / sizeof *entries
+      || super.cluster_ofs > super.size
+      || (super.cluster_cnt
+          > (super.size - super.cluster_ofs) / sizeof *clusters))
+    goto corrupt;
+
+  entries = malloc (super.file_cnt * sizeof *entries);
+  clusters = malloc (super.cluster_cnt * sizeof *clusters);
+  inodes = calloc (super.file_cnt, sizeof *inodes);
+  if ((super.file_cnt > 0 && (entries == NULL || inodes == NULL))
+      || (super.cluster_cnt > 0 && clusters == NULL))
+    PANIC ("romfs: out of memory");
+
+  p = read_range (super.dir_ofs, super.file_cnt * sizeof *entries,
+                  &entry_buf);
+  if (p == NULL)
+    PANIC ("romfs: out of memory");
+  memcpy (entries, p, super.file_cnt * sizeof *entries);
+  p = read_range (super.cluster_ofs, super.cluster_cnt * sizeof *clusters,
+                  &cluster_buf);
+  if (p == NULL)
+    PANIC ("romfs: out of memory");
+  memcpy (clusters, p, super.cluster_cnt * sizeof *clusters);
+  free (entry_buf);
+  free (cluster_buf);
+
+  if (!check_image ())
+    goto corrupt;
+
+  printf ("romfs: %"PRIu32" files in %"PRIu32"-byte image on %s.\n",
+          super.file_cnt, super.size, block_name (device));
+  return;
+
+ corrupt:
+  printf ("romfs: %s: corrupt image, not mounted.\n", block_name (device));
+  device = NULL;
+}
+
+/* Returns true if an image was found and mounted. */
+bool
+romfs_mounted (void)
+{
+  return device != NULL;
+}
+
+/* Opens the file named NAME in the image and returns its inode,
+   or a null pointer if there is no image or no such file. */
+struct inode *
+romfs_open_name (const char *name)
+{
+  size_t lo = 0, hi;
+
+  if (device == NULL)
+    return NULL;
+
+  /* Binary search of [LO, HI). */
+  hi = super.file_cnt;
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      int cmp = strcmp (name, entries[mid].name);
+
+      if (cmp == 0)
+        return romfs_open (ROMFS_INUMBER_BASE + mid);
+      else if (cmp < 0)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+  return NULL;
+}
+
+/* Opens and returns the romfs inode numbered INUMBER, or a null
+   pointer if there is no such file or memory is short. */
+struct inode *
+romfs_open (block_sector_t inumber)
+{
+  size_t idx = inumber - ROMFS_INUMBER_BASE;
+  struct inode *inode;
+
+  if (device == NULL || idx >= super.file_cnt)
+    return NULL;
+
+  lock_acquire (&romfs_lock);
+  inode = inodes[idx];
+  if (inode == NULL)
+    {
+      inode = calloc (1, sizeof *inode);
+      if (inode != NULL)
+        {
+          inode->sector = inumber;
+          inode->tail_ofs = -1;
+          inode->data.length = entries[idx].size;
+          inode->data.sector = inumber;
+          inodes[idx] = inode;
+        }
+    }
+  if (inode != NULL)
+    inode->open_cnt++;
+  lock_release (&romfs_lock);
+
+  return inode;
+}
+
+/* Closes romfs INODE, freeing it and dropping its data from the
+   page cache if this was the last opener. */
+void
+romfs_close (struct inode *inode)
+{
+  size_t idx = inode->sector - ROMFS_INUMBER_BASE;
+  bool last;
+
+  lock_acquire (&romfs_lock);
+  ASSERT (inodes[idx] == inode && inode->open_cnt > 0);
+  last = --inode->open_cnt == 0;
+  if (last)
+    inodes[idx] = NULL;
+  lock_release (&romfs_lock);
+
+  if (last)
+    {
+      cache_drop (inode);
+      free (inode);
+    }
+}
+
+/* Reads SIZE bytes from romfs INODE into BUFFER, starting at
+   position OFFSET.  Returns the number of bytes actually read,
+   which may be less than SIZE if end of file is reached, memory
+   is short, or a cluster fails to decompress. */
+off_t
+romfs_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
+{
+  const struct romfs_entry *e = &entries[inode->sector
+                                         - ROMFS_INUMBER_BASE];
+  uint8_t *buffer = buffer_;
+  uint8_t *bounce = NULL;
+  off_t bytes_read = 0;
+
+  while (size > 0)
+    {
+      uint32_t idx = offset / ROMFS_CLUSTER_SIZE;
+      off_t cluster_ofs = offset % ROMFS_CLUSTER_SIZE;
+      off_t file_left = (off_t) e->size - offset;
+      off_t cluster_left = ROMFS_CLUSTER_SIZE - cluster_ofs;
+      off_t chunk_size = size < cluster_left ? size : cluster_left;
+      size_t cluster_len;
+
+      if (file_left < chunk_size)
+        chunk_size = file_left;
+      if (chunk_size <= 0)
+        break;
+
+      cluster_len = e->size - idx * ROMFS_CLUSTER_SIZE;
+      if (cluster_len > ROMFS_CLUSTER_SIZE)
+        cluster_len = ROMFS_CLUSTER_SIZE;
+
+      if (cluster_ofs == 0 && (size_t) chunk_size == cluster_len)
+        {
+          /* Decompress a whole cluster directly into BUFFER. */
+          if (!read_cluster (e->first_cluster + idx, buffer + bytes_read,
+                             cluster_len))
+            break;
+        }
+      else
+        {
+          /* Decompress into a bounce buffer, then copy the part
+             we want. */
+          if (bounce == NULL)
+            {
+              bounce = malloc (ROMFS_CLUSTER_SIZE);
+              if (bounce == NULL)
+                break;
+            }
+          if (!read_cluster (e->first_cluster + idx, bounce, cluster_len))
+            break;
+          memcpy (buffer + bytes_read, bounce + cluster_ofs, chunk_size);
+        }
+
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_read += chunk_size;
+    }
+  free (bounce);
+
+  return bytes_read;
+}
+
+/* Returns true if every directory entry and cluster in the image
+   lies within it and the directory is sorted. */
+static bool
+check_image (void)
+{
+  uint32_t i;
+
+  for (i = 0; i < super.file_cnt; i++)
+    {
+      struct romfs_entry *e = &entries[i];
+      uint32_t cnt = DIV_ROUND_UP (e->size, ROMFS_CLUSTER_SIZE);
+
+      e->name[NAME_MAX] = '\0';
+      if (e->first_cluster > super.cluster_cnt
+          || cnt > super.cluster_cnt - e->first_cluster
+          || (i > 0 && strcmp (entries[i - 1].name, e->name) >= 0))
+        return false;
+    }
+  for (i = 0; i < super.cluster_cnt; i++)
+    {
+      struct romfs_cluster *c = &clusters[i];
+      if (c->size > ROMFS_CLUSTER_SIZE || c->ofs > super.size
+          || c->size > super.size - c->ofs)
+        return false;
+    }
+  return true;
+}
+
+/* Reads the SIZE bytes at byte offset OFS in the image into a new
+   buffer, which it stores in *BUFFERP for the caller to free.
+   Returns a pointer to the bytes within that buffer, or a null
+   pointer if memory is short. */
+static void *
+read_range (uint32_t ofs, size_t size, void **bufferp)
+{
+  block_sector_t first = ofs / BLOCK_SECTOR_SIZE;
+  block_sector_t cnt = DIV_ROUND_UP (ofs % BLOCK_SECTOR_SIZE + size,
+                                     BLOCK_SECTOR_SIZE);
+  uint8_t *buffer;
+
+  buffer = malloc (cnt > 0 ? cnt * BLOCK_SECTOR_SIZE : 1);
+  *bufferp = buffer;
+  if (buffer == NULL)
+    return NULL;
+  if (cnt > 0)
+    block_read_multiple (device, first, cnt, buffer);
+  return buffer + ofs % BLOCK_SECTOR_SIZE;
+}
+
+/* Reads cluster IDX, which holds LENGTH bytes of file data, into
+   DST.  Returns true if successful, false if memory is short or
+   the cluster does not decompress to LENGTH bytes. */
+static bool
+read_cluster (uint32_t idx, uint8_t *dst, size_t length)
+{
+  const struct romfs_cluster *c = &clusters[idx];
+  void *buffer;
+  const uint8_t *data = read_range (c->ofs, c->size, &buffer);
+  bool success;
+
+  if (data == NULL)
+    success = false;
+  else if (c->size == length)
+    {
+      memcpy (dst, data, length);
+      success = true;
+    }
+  else
+    success = lz_decompress (data, c->size, dst, length) == length;
+  free (buffer);
+
+  return success;
+}
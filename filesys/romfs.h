@@ -0,0 +1,68 @@
+#ifndef FILESYS_ROMFS_H
+#define FILESYS_ROMFS_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+/* Read-only boot image.
+
+   utils/pintos-mkrom packs a set of files, typically the
+   programs a run needs, into one compressed image, which the
+   kernel mounts at boot if the scratch device holds one.  Files
+   in the image can then be opened as "/rom/NAME" and executed
+   as plain "NAME" without being extracted into the file system
+   first.
+
+   The image is laid out as follows, in byte offsets from the
+   start of the device:
+
+     - Sector 0: a `struct romfs_super'.
+
+     - At DIR_OFS, FILE_CNT `struct romfs_entry's, sorted by
+       name, so that a lookup is a binary search.
+
+     - At CLUSTER_OFS, CLUSTER_CNT `struct romfs_cluster's.  A
+       file's data is split into ROMFS_CLUSTER_SIZE-byte clusters
+       (the last may be short), and its clusters are consecutive
+       in this table, starting at the entry's FIRST_CLUSTER.
+
+     - The clusters themselves, each compressed with lz_compress()
+       or, if that does not make it smaller, stored as is, packed
+       back to back without regard to sector boundaries.
+
+   A romfs inode is an ordinary `struct inode' whose inode number
+   is ROMFS_INUMBER_BASE plus the file's index in the directory;
+   inode.c passes such inodes to romfs, which refuses all writes. */
+
+/* Name under the root directory at which the image appears. */
+#define ROMFS_MOUNT "rom"
+
+/* Identifies an image: "PROM" in little-endian byte order. */
+#define ROMFS_MAGIC 0x4d4f5250
+
+/* Uncompressed size of a cluster.  It matches the page size, so
+   that the page cache fills each page from a single cluster. */
+#define ROMFS_CLUSTER_SIZE 4096
+
+/* Inode numbers that belong to romfs. */
+#define ROMFS_INUMBER_BASE 0x30000000
+#define ROMFS_INUMBER_CNT 0x10000000
+
+struct inode;
+
+void romfs_init (void);
+bool romfs_mounted (void);
+struct inode *romfs_open_name (const char *name);
+struct inode *romfs_open (block_sector_t);
+void romfs_close (struct inode *);
+off_t romfs_read_at (struct inode *, void *, off_t size, off_t offset);
+
+/* Returns true if INUMBER is a romfs inode number. */
+static inline bool
+romfs_owns (block_sector_t inumber)
+{
+  return inumber - ROMFS_INUMBER_BASE < ROMFS_INUMBER_CNT;
+}
+
+#endif /* filesys/romfs.h */
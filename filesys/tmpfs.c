@@ -0,0 +1,436 @@
+#include "filesys/tmpfs.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/swap.h"
+#endif
+
+/* Most data pages tmpfs keeps in memory at once.  They come from
+   the user pool.  Past this limit, or when the pool runs dry,
+   the least recently used page is written to swap to make room
+   if there is swap (with VM); otherwise the write that needs the
+   page comes up short, as if the disk were full. */
+#define TMPFS_RESIDENT_MAX 128
+
+/* Entries a new tmpfs root directory has room for. */
+#define ROOT_ENTRY_CNT 16
+
+/* A page of file data. */
+struct tmpfs_page
+  {
+    struct list_elem elem;              /* Element in `resident'. */
+    uint8_t *kpage;                     /* Data, or null if swapped out. */
+    size_t swap_slot;                   /* Where the data is if swapped. */
+    int pin_cnt;                        /* Copies in progress; pinned
+                                           pages are never swapped. */
+  };
+
+/* A file or directory.  INODE comes first, so that the `struct
+   inode *' tmpfs hands out converts back to its node. */
+struct tmpfs_node
+  {
+    struct inode inode;                 /* Inode seen by everyone else. */
+    struct hash_elem hash_elem;         /* Element in `nodes'. */
+    struct tmpfs_page **pages;          /* Data pages, null for holes. */
+    size_t page_cnt;                    /* Number of elements in PAGES. */
+  };
+
+static struct hash nodes;               /* Every node, open or not. */
+static struct list resident;            /* Pages in memory, least
+                                           recently used first. */
+static size_t resident_cnt;             /* Number of pages in memory. */
+static block_sector_t next_inumber;     /* Next inode number to give. */
+static struct lock tmpfs_lock;          /* Protects all of the above. */
+
+static hash_hash_func node_hash;
+static hash_less_func node_less;
+static struct tmpfs_node *lookup (block_sector_t inumber);
+static struct tmpfs_page *get_page (struct tmpfs_node *, size_t idx);
+static uint8_t *get_kpage (void);
+static void free_node (struct tmpfs_node *);
+
+/* Initializes tmpfs and creates its empty root directory, whose
+   parent is the root directory of the file system device. */
+void
+tmpfs_init (void)
+{
+  hash_init (&nodes, node_hash, node_less, NULL);
+  list_init (&resident);
+  lock_init (&tmpfs_lock);
+  next_inumber = TMPFS_ROOT_INUMBER + 1;
+
+  if (!dir_create (TMPFS_ROOT_INUMBER, ROOT_ENTRY_CNT, ROOT_DIR_SECTOR))
+    PANIC ("tmpfs root directory creation failed");
+}
+
+/* Picks an unused tmpfs inode number and stores it in *INUMBERP,
+   for a following tmpfs_create().  Returns true if successful,
+   false if tmpfs has run out of inode numbers. */
+bool
+tmpfs_allocate (block_sector_t *inumberp)
+{
+  bool success;
+
+  lock_acquire (&tmpfs_lock);
+  success = next_inumber != 0;
+  if (success)
+    *inumberp = next_inumber++;
+  lock_release (&tmpfs_lock);
+
+  return success;
+}
+
+/* Creates a tmpfs inode numbered INUMBER with LENGTH bytes of
+   zeros, holding a directory if IS_DIR.  Pages are allocated
+   only as data is written.  Returns true if successful, false if
+   memory is short. */
+bool
+tmpfs_create (block_sector_t inumber, off_t length, bool is_dir)
+{
+  struct tmpfs_node *node;
+  struct inode *inode;
+
+  ASSERT (tmpfs_owns (inumber));
+  ASSERT (length >= 0);
+
+  node = calloc (1, sizeof *node);
+  if (node == NULL)
+    return false;
+
+  inode = &node->inode;
+  inode->sector = inumber;
+  inode->tail_ofs = -1;
+  inode->data.length = length;
+  inode->data.sector = inumber;
+  inode->data.is_dir = is_dir;
+
+  lock_acquire (&tmpfs_lock);
+  hash_insert (&nodes, &node->hash_elem);
+  lock_release (&tmpfs_lock);
+  return true;
+}
+
+/* Opens and returns the tmpfs inode numbered INUMBER, or a null
+   pointer if there is no such inode. */
+struct inode *
+tmpfs_open (block_sector_t inumber)
+{
+  struct tmpfs_node *node;
+
+  lock_acquire (&tmpfs_lock);
+  node = lookup (inumber);
+  if (node != NULL)
+    node->inode.open_cnt++;
+  lock_release (&tmpfs_lock);
+
+  return node != NULL ? &node->inode : NULL;
+}
+
+/* Closes tmpfs INODE.  An inode that is no longer open stays in
+   memory, since nothing else holds its data, until it has been
+   removed as well. */
+void
+tmpfs_close (struct inode *inode)
+{
+  struct tmpfs_node *node = (struct tmpfs_node *) inode;
+
+  lock_acquire (&tmpfs_lock);
+  ASSERT (inode->open_cnt > 0);
+  if (--inode->open_cnt == 0 && inode->removed)
+    free_node (node);
+  lock_release (&tmpfs_lock);
+}
+
+/* Reads SIZE bytes from tmpfs INODE into BUFFER, starting at
+   position OFFSET.  Holes read as zeros.  Returns the number of
+   bytes actually read, which may be less than SIZE if end of
+   file is reached or a swapped-out page cannot be brought back. */
+off_t
+tmpfs_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
+{
+  struct tmpfs_node *node = (struct tmpfs_node *) inode;
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  while (size > 0)
+    {
+      size_t idx = offset / PGSIZE;
+      off_t page_ofs = offset % PGSIZE;
+      off_t inode_left = inode_length (inode) - offset;
+      off_t page_left = PGSIZE - page_ofs;
+      off_t chunk_size = size < page_left ? size : page_left;
+      struct tmpfs_page *p = NULL;
+      bool hole;
+
+      if (inode_left < chunk_size)
+        chunk_size = inode_left;
+      if (chunk_size <= 0)
+        break;
+
+      lock_acquire (&tmpfs_lock);
+      hole = idx >= node->page_cnt || node->pages[idx] == NULL;
+      if (!hole)
+        {
+          p = get_page (node, idx);
+          if (p != NULL)
+            p->pin_cnt++;
+        }
+      lock_release (&tmpfs_lock);
+
+      if (hole)
+        memset (buffer + bytes_read, 0, chunk_size);
+      else if (p != NULL)
+        {
+          /* Copy without holding the lock: BUFFER may be user
+             memory whose page fault needs tmpfs. */
+          memcpy (buffer + bytes_read, p->kpage + page_ofs, chunk_size);
+
+          lock_acquire (&tmpfs_lock);
+          p->pin_cnt--;
+          lock_release (&tmpfs_lock);
+        }
+      else
+        break;
+
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_read += chunk_size;
+    }
+
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into tmpfs INODE, starting at
+   OFFSET, extending the inode if the write ends past end of
+   file.  Returns the number of bytes actually written, which may
+   be less than SIZE if memory (and swap) runs out or writes are
+   denied. */
+off_t
+tmpfs_write_at (struct inode *inode, const void *buffer_, off_t size,
+                off_t offset)
+{
+  struct tmpfs_node *node = (struct tmpfs_node *) inode;
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = 0;
+
+  if (inode->deny_write_cnt)
+    return 0;
+
+  while (size > 0)
+    {
+      off_t page_ofs = offset % PGSIZE;
+      off_t page_left = PGSIZE - page_ofs;
+      off_t chunk_size = size < page_left ? size : page_left;
+      struct tmpfs_page *p;
+
+      lock_acquire (&tmpfs_lock);
+      p = get_page (node, offset / PGSIZE);
+      if (p != NULL)
+        p->pin_cnt++;
+      lock_release (&tmpfs_lock);
+      if (p == NULL)
+        break;
+
+      memcpy (p->kpage + page_ofs, buffer + bytes_written, chunk_size);
+
+      lock_acquire (&tmpfs_lock);
+      p->pin_cnt--;
+      if (offset + chunk_size > inode_length (inode))
+        inode->data.length = offset + chunk_size;
+      lock_release (&tmpfs_lock);
+
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+    }
+
+  return bytes_written;
+}
+
+/* Returns a hash value for node N. */
+static unsigned
+node_hash (const struct hash_elem *n_, void *aux UNUSED)
+{
+  const struct tmpfs_node *n = hash_entry (n_, struct tmpfs_node,
+                                           hash_elem);
+  return hash_int (n->inode.sector);
+}
+
+/* Returns true if node A precedes node B. */
+static bool
+node_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct tmpfs_node *a = hash_entry (a_, struct tmpfs_node,
+                                           hash_elem);
+  const struct tmpfs_node *b = hash_entry (b_, struct tmpfs_node,
+                                           hash_elem);
+  return a->inode.sector < b->inode.sector;
+}
+
+/* Returns the node numbered INUMBER, or a null pointer if there
+   is none. */
+static struct tmpfs_node *
+lookup (block_sector_t inumber)
+{
+  struct tmpfs_node key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&tmpfs_lock));
+
+  key.inode.sector = inumber;
+  e = hash_find (&nodes, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct tmpfs_node, hash_elem) : NULL;
+}
+
+/* Returns NODE's page IDX, allocating it if it is a hole or
+   reading it back if it is swapped out, and marks it most
+   recently used.  Returns a null pointer if no memory can be
+   found for it. */
+static struct tmpfs_page *
+get_page (struct tmpfs_node *node, size_t idx)
+{
+  struct tmpfs_page *p;
+
+  ASSERT (lock_held_by_current_thread (&tmpfs_lock));
+
+  if (idx >= node->page_cnt)
+    {
+      size_t new_cnt = node->page_cnt * 2;
+      struct tmpfs_page **pages;
+
+      if (new_cnt <= idx)
+        new_cnt = idx + 1;
+      pages = realloc (node->pages, new_cnt * sizeof *pages);
+      if (pages == NULL)
+        return NULL;
+      memset (pages + node->page_cnt, 0,
+              (new_cnt - node->page_cnt) * sizeof *pages);
+      node->pages = pages;
+      node->page_cnt = new_cnt;
+    }
+
+  p = node->pages[idx];
+  if (p == NULL)
+    {
+      p = malloc (sizeof *p);
+      if (p == NULL)
+        return NULL;
+      p->kpage = get_kpage ();
+      if (p->kpage == NULL)
+        {
+          free (p);
+          return NULL;
+        }
+      p->pin_cnt = 0;
+      node->pages[idx] = p;
+    }
+  else if (p->kpage == NULL)
+    {
+#ifdef VM
+      uint8_t *kpage = get_kpage ();
+      if (kpage == NULL)
+        return NULL;
+      read_from_block ((uint32_t *) kpage, p->swap_slot);
+      p->kpage = kpage;
+#else
+      NOT_REACHED ();
+#endif
+    }
+  else
+    {
+      list_remove (&p->elem);
+      resident_cnt--;
+    }
+
+  list_push_back (&resident, &p->elem);
+  resident_cnt++;
+  return p;
+}
+
+/* Returns a zeroed page for tmpfs data, or a null pointer if
+   none can be found. */
+static uint8_t *
+get_kpage (void)
+{
+  uint8_t *kpage = NULL;
+
+  if (resident_cnt < TMPFS_RESIDENT_MAX)
+    kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+
+#ifdef VM
+  /* Take over the least recently used unpinned page, after
+     writing its data to swap. */
+  if (kpage == NULL)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&resident); e != list_end (&resident);
+           e = list_next (e))
+        {
+          struct tmpfs_page *victim = list_entry (e, struct tmpfs_page,
+                                                  elem);
+          size_t slot;
+
+          if (victim->pin_cnt > 0)
+            continue;
+          slot = try_write_to_block ((uint32_t *) victim->kpage);
+          if (slot == BITMAP_ERROR)
+            break;
+
+          list_remove (&victim->elem);
+          resident_cnt--;
+          victim->swap_slot = slot;
+          kpage = victim->kpage;
+          victim->kpage = NULL;
+          memset (kpage, 0, PGSIZE);
+          break;
+        }
+    }
+#endif
+
+  return kpage;
+}
+
+/* Frees NODE and all of its data. */
+static void
+free_node (struct tmpfs_node *node)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&tmpfs_lock));
+
+  for (i = 0; i < node->page_cnt; i++)
+    {
+      struct tmpfs_page *p = node->pages[i];
+
+      if (p == NULL)
+        continue;
+      ASSERT (p->pin_cnt == 0);
+      if (p->kpage != NULL)
+        {
+          list_remove (&p->elem);
+          resident_cnt--;
+          palloc_free_page (p->kpage);
+        }
+#ifdef VM
+      else
+        free_block (p->swap_slot);
+#endif
+      free (p);
+    }
+
+  hash_delete (&nodes, &node->hash_elem);
+  free (node->pages);
+  free (node);
+}
@@ -0,0 +1,44 @@
+#ifndef FILESYS_TMPFS_H
+#define FILESYS_TMPFS_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+/* Memory-backed file system.
+
+   Paths that start with "/tmp" name files and directories in
+   tmpfs, whose inodes and data live in memory pages instead of
+   on the file system device, so they never cause disk I/O (but
+   do not survive a reboot).  A tmpfs inode is an ordinary
+   `struct inode', used through the same file and directory
+   interfaces as any other; inode.c passes an inode to tmpfs
+   whenever its inode number is one of tmpfs's, which lie above
+   every sector of the file system device. */
+
+/* Name under the root directory at which tmpfs is mounted. */
+#define TMPFS_MOUNT "tmp"
+
+/* Inode number of the tmpfs root directory, and the lowest inode
+   number that belongs to tmpfs. */
+#define TMPFS_ROOT_INUMBER 0x40000000
+
+struct inode;
+
+void tmpfs_init (void);
+bool tmpfs_allocate (block_sector_t *);
+bool tmpfs_create (block_sector_t, off_t length, bool is_dir);
+struct inode *tmpfs_open (block_sector_t);
+void tmpfs_close (struct inode *);
+off_t tmpfs_read_at (struct inode *, void *, off_t size, off_t offset);
+off_t tmpfs_write_at (struct inode *, const void *, off_t size,
+                      off_t offset);
+
+/* Returns true if INUMBER is a tmpfs inode number. */
+static inline bool
+tmpfs_owns (block_sector_t inumber)
+{
+  return inumber >= TMPFS_ROOT_INUMBER;
+}
+
+#endif /* filesys/tmpfs.h */
@@ -0,0 +1,37 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+/* Packed directory entries, as returned by the readdir_bulk
+   system call.  Shared between the kernel, which fills the
+   buffer, and user programs, which walk it. */
+
+#include <round.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Flags for readdir_bulk(). */
+#define READDIR_STAT 0x1        /* Also report each entry's type and size. */
+
+/* Values for d_type. */
+#define DT_UNKNOWN 0            /* Type not requested. */
+#define DT_REG 1                /* Regular file. */
+#define DT_DIR 2                /* Directory. */
+
+/* A directory entry.  Entries are laid out back to back in the
+   caller's buffer, each starting on a 4-byte boundary; D_RECLEN
+   is the distance from the start of one entry to the next. */
+struct dirent
+  {
+    uint16_t d_reclen;          /* Bytes from this entry to the next. */
+    uint8_t d_type;             /* DT_* value. */
+    uint8_t d_namlen;           /* Length of d_name, not counting null. */
+    int32_t d_ino;              /* Inode number. */
+    int32_t d_size;             /* Size in bytes, or -1 if not requested. */
+    char d_name[];              /* Null-terminated file name. */
+  };
+
+/* Number of bytes an entry with a NAMLEN-byte name occupies. */
+#define DIRENT_RECLEN(NAMLEN) \
+        ROUND_UP (offsetof (struct dirent, d_name) + (NAMLEN) + 1, 4)
+
+#endif /* lib/dirent.h */
@@ -0,0 +1,41 @@
+#ifndef __LIB_IOSTAT_H
+#define __LIB_IOSTAT_H
+
+/* Block device statistics, as returned by the iostat system
+   call.  Shared between the kernel, which fills them in, and
+   user programs such as the tests/filesys/perf workloads. */
+
+#include <stdint.h>
+
+/* Devices iostat() can report on.  These match the roles in
+   enum block_type. */
+#define IOSTAT_KERNEL 0         /* Pintos OS kernel. */
+#define IOSTAT_FILESYS 1        /* File system. */
+#define IOSTAT_SCRATCH 2        /* Scratch. */
+#define IOSTAT_SWAP 3           /* Swap. */
+
+/* Buckets in a latency histogram.  Bucket B counts requests that
+   took from 2**B up to 2**(B+1) CPU cycles, as counted by the
+   time-stamp counter; the last bucket also counts anything
+   slower. */
+#define IOSTAT_HIST_CNT 32
+
+struct iostat
+  {
+    int64_t ticks;              /* Timer ticks since boot. */
+    int32_t ticks_per_sec;      /* Timer ticks per second. */
+    uint64_t read_cnt;          /* Sectors read from the device. */
+    uint64_t write_cnt;         /* Sectors written to the device. */
+    uint64_t read_reqs;         /* Read requests. */
+    uint64_t write_reqs;        /* Write requests. */
+    uint64_t seq_reqs;          /* Requests that began where the
+                                   previous one ended. */
+    uint64_t random_reqs;       /* Requests that had to seek. */
+    uint32_t max_waiters;       /* Most requests ever found ahead of
+                                   a new one for the device's
+                                   channel. */
+    uint32_t read_hist[IOSTAT_HIST_CNT];  /* Read latencies. */
+    uint32_t write_hist[IOSTAT_HIST_CNT]; /* Write latencies. */
+  };
+
+#endif /* lib/iostat.h */
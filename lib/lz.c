@@ -0,0 +1,202 @@
+#include <lz.h>
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Shortest back-reference worth encoding. */
+#define MIN_MATCH 4
+
+/* Hash table of recent positions, indexed by the hash of the 4
+   bytes found there. */
+#define HASH_BITS 10
+#define HASH_CNT (1 << HASH_BITS)
+
+/* A token packs two 4-bit lengths; this value in either says
+   that more length bytes follow. */
+#define RUN_MASK 15
+
+/* Returns the hash of the 4 bytes at P. */
+static unsigned
+hash4 (const uint8_t *p)
+{
+  uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Appends the part of LENGTH that did not fit in its 4-bit token
+   field to OP, which must not pass OP_END.  Returns the new end
+   of output, or a null pointer if it does not fit. */
+static uint8_t *
+put_length (uint8_t *op, uint8_t *op_end, size_t length)
+{
+  if (length < RUN_MASK)
+    return op;
+  for (length -= RUN_MASK; ; length -= 255)
+    {
+      if (op >= op_end)
+        return NULL;
+      if (length < 255)
+        {
+          *op++ = length;
+          return op;
+        }
+      *op++ = 255;
+    }
+}
+
+/* Appends a sequence to OP: LIT_LEN literal bytes from LIT, then,
+   if MATCH_LEN is nonzero, a back-reference of MATCH_LEN bytes
+   starting OFFSET bytes back.  Returns the new end of output, or
+   a null pointer if the sequence does not fit before OP_END. */
+static uint8_t *
+put_sequence (uint8_t *op, uint8_t *op_end, const uint8_t *lit,
+              size_t lit_len, size_t offset, size_t match_len)
+{
+  size_t extra = match_len > 0 ? match_len - MIN_MATCH : 0;
+  uint8_t *token;
+
+  if (op >= op_end)
+    return NULL;
+  token = op++;
+  *token = ((lit_len < RUN_MASK ? lit_len : RUN_MASK) << 4
+            | (extra < RUN_MASK ? extra : RUN_MASK));
+
+  op = put_length (op, op_end, lit_len);
+  if (op == NULL || (size_t) (op_end - op) < lit_len)
+    return NULL;
+  memcpy (op, lit, lit_len);
+  op += lit_len;
+
+  if (match_len == 0)
+    return op;
+  if (op_end - op < 2)
+    return NULL;
+  *op++ = offset & 0xff;
+  *op++ = offset >> 8;
+  return put_length (op, op_end, extra);
+}
+
+/* Compresses the SRC_SIZE bytes at SRC, which may be at most
+   LZ_MAX_INPUT, into DST, which has room for DST_SIZE bytes.
+   WORK must point to LZ_WORK_SIZE bytes of scratch memory.
+   Returns the compressed size, or 0 if the result would not fit
+   in DST_SIZE bytes. */
+size_t
+lz_compress (const void *src_, size_t src_size,
+             void *dst_, size_t dst_size, void *work)
+{
+  const uint8_t *src = src_;
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;
+  const uint8_t *end = src + src_size;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *op_end = dst + dst_size;
+  uint16_t *table = work;
+
+  ASSERT (src_size <= LZ_MAX_INPUT);
+  ASSERT (HASH_CNT * sizeof *table <= LZ_WORK_SIZE);
+
+  memset (table, 0, HASH_CNT * sizeof *table);
+  while (end - ip >= MIN_MATCH)
+    {
+      unsigned h = hash4 (ip);
+      const uint8_t *ref = src + table[h];
+
+      table[h] = ip - src;
+      if (ref < ip && ip - ref <= 0xffff && !memcmp (ref, ip, MIN_MATCH))
+        {
+          size_t match_len = MIN_MATCH;
+
+          while (ip + match_len < end && ref[match_len] == ip[match_len])
+            match_len++;
+          op = put_sequence (op, op_end, anchor, ip - anchor,
+                             ip - ref, match_len);
+          if (op == NULL)
+            return 0;
+          ip += match_len;
+          anchor = ip;
+        }
+      else
+        ip++;
+    }
+
+  if (anchor < end)
+    {
+      op = put_sequence (op, op_end, anchor, end - anchor, 0, 0);
+      if (op == NULL)
+        return 0;
+    }
+  return op - dst;
+}
+
+/* Adds the length bytes at *IP, which must not pass IP_END, to
+   *LENGTH and advances *IP past them.  Returns false if the input
+   ends first. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *ip_end, size_t *length)
+{
+  uint8_t b;
+
+  do
+    {
+      if (*ip >= ip_end)
+        return false;
+      b = *(*ip)++;
+      *length += b;
+    }
+  while (b == 255);
+  return true;
+}
+
+/* Decompresses from SRC, which holds SRC_SIZE bytes, into DST
+   until DST_SIZE bytes have been produced.  Returns DST_SIZE if
+   successful, or 0 if SRC is corrupt or too short. */
+size_t
+lz_decompress (const void *src, size_t src_size, void *dst_, size_t dst_size)
+{
+  const uint8_t *ip = src;
+  const uint8_t *ip_end = ip + src_size;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *op_end = dst + dst_size;
+
+  while (op < op_end)
+    {
+      size_t lit_len, match_len, offset;
+      unsigned token;
+
+      if (ip >= ip_end)
+        return 0;
+      token = *ip++;
+
+      lit_len = token >> 4;
+      if (lit_len == RUN_MASK && !get_length (&ip, ip_end, &lit_len))
+        return 0;
+      if (lit_len > (size_t) (ip_end - ip) || lit_len > (size_t) (op_end - op))
+        return 0;
+      memcpy (op, ip, lit_len);
+      ip += lit_len;
+      op += lit_len;
+      if (op == op_end)
+        break;
+
+      if (ip_end - ip < 2)
+        return 0;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      match_len = token & RUN_MASK;
+      if (match_len == RUN_MASK && !get_length (&ip, ip_end, &match_len))
+        return 0;
+      match_len += MIN_MATCH;
+      if (offset == 0 || offset > (size_t) (op - dst)
+          || match_len > (size_t) (op_end - op))
+        return 0;
+
+      /* Byte by byte, since a match may overlap its own output. */
+      for (; match_len > 0; match_len--, op++)
+        *op = op[-offset];
+    }
+  return op - dst;
+}
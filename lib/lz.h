@@ -0,0 +1,27 @@
+#ifndef __LIB_LZ_H
+#define __LIB_LZ_H
+
+/* A small, fast LZ77 codec in the style of LZ4.
+
+   Compressed data is a series of sequences, each a token byte,
+   a run of literal bytes, and a back-reference (a 2-byte offset
+   and a length) into the output produced so far.  The last
+   sequence has literals only.  The stream carries no length of
+   its own: the decoder stops once it has produced as many bytes
+   as the caller asked for, so trailing bytes, such as the rest
+   of a sector, are ignored. */
+
+#include <stddef.h>
+
+/* Bytes of scratch memory lz_compress() needs. */
+#define LZ_WORK_SIZE 2048
+
+/* Largest input lz_compress() accepts. */
+#define LZ_MAX_INPUT 65536
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size, void *work);
+size_t lz_decompress (const void *src, size_t src_size,
+                      void *dst, size_t dst_size);
+
+#endif /* lib/lz.h */
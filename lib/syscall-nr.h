@@ -28,7 +28,16 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_READDIR_BULK,           /* Reads many directory entries at once. */
+    SYS_IOSTAT,                 /* Reads block device statistics. */
+    SYS_DEFRAG,                 /* Defragments the file system. */
+    SYS_CLONE,                  /* Copies a file by sharing its sectors. */
+    SYS_COPY_FILE_RANGE,        /* Copies data between open files. */
+    SYS_COMPRESS,               /* Turns on compression for a file. */
+    SYS_FORK                    /* Copies this process. */
   };
 
 #endif /* lib/syscall-nr.h */
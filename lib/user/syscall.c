@@ -61,6 +61,25 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "g" (ARG0),                             \
+                 [arg1] "g" (ARG1),                             \
+                 [arg2] "g" (ARG2),                             \
+                 [arg3] "g" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
 void
 halt (void) 
 {
@@ -182,3 +201,45 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+readdir_bulk (int fd, void *buffer, unsigned size, int flags)
+{
+  return syscall4 (SYS_READDIR_BULK, fd, buffer, size, flags);
+}
+
+bool
+iostat (int device, struct iostat *st)
+{
+  return syscall2 (SYS_IOSTAT, device, st);
+}
+
+int
+defrag (void)
+{
+  return syscall0 (SYS_DEFRAG);
+}
+
+bool
+clone (const char *src, const char *dst)
+{
+  return syscall2 (SYS_CLONE, src, dst);
+}
+
+int
+copy_file_range (int fd_in, int fd_out, unsigned size)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, fd_in, fd_out, size);
+}
+
+bool
+compress (int fd)
+{
+  return syscall1 (SYS_COMPRESS, fd);
+}
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
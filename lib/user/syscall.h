@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <dirent.h>
+#include <iostat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +47,13 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int readdir_bulk (int fd, void *buffer, unsigned size, int flags);
+bool iostat (int device, struct iostat *);
+int defrag (void);
+bool clone (const char *src, const char *dst);
+int copy_file_range (int fd_in, int fd_out, unsigned size);
+bool compress (int fd);
+pid_t fork (void);
+
 #endif /* lib/user/syscall.h */
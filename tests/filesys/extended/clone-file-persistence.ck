@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($dst) = random_bytes (20100);
+substr ($dst, 1000, 3000) = 'x' x 3000;
+$dst .= 'z' x 100;
+check_archive ({"d" => {"dst" => [$dst]}});
+pass;
@@ -0,0 +1,73 @@
+/* Clones a file while a descriptor for it holds a buffered
+   append, then checks that the clone has all the data, that
+   writes to either file after cloning, including growing the
+   clone, do not show through to the other, and that the clone
+   outlives the removal of the original.  Also checks that
+   cloning fails for an existing target, a missing or directory
+   source, and a target in tmpfs or in a missing directory. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 20000
+#define TAIL_SIZE 100
+#define PATCH_OFS 1000
+#define PATCH_SIZE 3000
+
+static char buf[FILE_SIZE + TAIL_SIZE];
+static char src_buf[FILE_SIZE + TAIL_SIZE];
+static char dst_buf[FILE_SIZE + 2 * TAIL_SIZE];
+
+void
+test_main (void)
+{
+  int fd, dst_fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+  memcpy (src_buf, buf, sizeof buf);
+  memset (src_buf + PATCH_OFS, 'y', PATCH_SIZE);
+  memcpy (dst_buf, buf, sizeof buf);
+  memset (dst_buf + PATCH_OFS, 'x', PATCH_SIZE);
+  memset (dst_buf + sizeof buf, 'z', TAIL_SIZE);
+
+  CHECK (create ("src", FILE_SIZE), "create \"src\"");
+  CHECK ((fd = open ("src")) > 1, "open \"src\"");
+  CHECK (write (fd, buf, FILE_SIZE) == FILE_SIZE, "write \"src\"");
+  CHECK (write (fd, buf + FILE_SIZE, TAIL_SIZE) == TAIL_SIZE,
+         "append to \"src\"");
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (clone ("src", "d/dst"), "clone \"src\" to \"d/dst\"");
+  CHECK (!clone ("src", "d/dst"), "clone to existing \"d/dst\" (must fail)");
+  CHECK (!clone ("missing", "other"), "clone \"missing\" (must fail)");
+  CHECK (!clone ("d", "other"), "clone directory \"d\" (must fail)");
+  CHECK (!clone ("src", "/tmp/dst"), "clone into tmpfs (must fail)");
+  CHECK (!clone ("src", "nodir/dst"),
+         "clone into missing directory (must fail)");
+  check_file ("d/dst", buf, sizeof buf);
+
+  seek (fd, PATCH_OFS);
+  CHECK (write (fd, src_buf + PATCH_OFS, PATCH_SIZE) == PATCH_SIZE,
+         "overwrite part of \"src\"");
+  msg ("close \"src\"");
+  close (fd);
+  check_file ("d/dst", buf, sizeof buf);
+
+  CHECK ((dst_fd = open ("d/dst")) > 1, "open \"d/dst\"");
+  seek (dst_fd, PATCH_OFS);
+  CHECK (write (dst_fd, dst_buf + PATCH_OFS, PATCH_SIZE) == PATCH_SIZE,
+         "overwrite part of \"d/dst\"");
+  seek (dst_fd, sizeof buf);
+  CHECK (write (dst_fd, dst_buf + sizeof buf, TAIL_SIZE) == TAIL_SIZE,
+         "append to \"d/dst\"");
+  msg ("close \"d/dst\"");
+  close (dst_fd);
+  check_file ("src", src_buf, sizeof src_buf);
+
+  CHECK (remove ("src"), "remove \"src\"");
+  check_file ("d/dst", dst_buf, sizeof dst_buf);
+}
@@ -0,0 +1,39 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(clone-file) begin
+(clone-file) create "src"
+(clone-file) open "src"
+(clone-file) write "src"
+(clone-file) append to "src"
+(clone-file) mkdir "d"
+(clone-file) clone "src" to "d/dst"
+(clone-file) clone to existing "d/dst" (must fail)
+(clone-file) clone "missing" (must fail)
+(clone-file) clone directory "d" (must fail)
+(clone-file) clone into tmpfs (must fail)
+(clone-file) clone into missing directory (must fail)
+(clone-file) open "d/dst" for verification
+(clone-file) verified contents of "d/dst"
+(clone-file) close "d/dst"
+(clone-file) overwrite part of "src"
+(clone-file) close "src"
+(clone-file) open "d/dst" for verification
+(clone-file) verified contents of "d/dst"
+(clone-file) close "d/dst"
+(clone-file) open "d/dst"
+(clone-file) overwrite part of "d/dst"
+(clone-file) append to "d/dst"
+(clone-file) close "d/dst"
+(clone-file) open "src" for verification
+(clone-file) verified contents of "src"
+(clone-file) close "src"
+(clone-file) remove "src"
+(clone-file) open "d/dst" for verification
+(clone-file) verified contents of "d/dst"
+(clone-file) close "d/dst"
+(clone-file) end
+EOF
+pass;
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($data) = join ('', map (chr (ord ('a') + int ($_ / 7) % 26), 0...19999));
+substr ($data, 8192, 4096) = random_bytes (4096);
+substr ($data, 12288, 4096) = "\0" x 4096;
+substr ($data, 3500, 1100) = 'x' x 1100;
+substr ($data, 13288, 500) = 'f' x 500;
+$data .= "\0" x 4000 . 'g' x 1000;
+check_archive ({"d" => {}, "data" => [$data]});
+pass;
@@ -0,0 +1,96 @@
+/* Turns on compression for a file holding repetitive text, one
+   cluster of random bytes, one cluster of zeros, and a partial
+   last cluster.  Checks that compress() refuses directories, bad
+   descriptors, and files already compressed, that reading the file
+   back moves fewer sectors than it holds and reading the zero
+   cluster moves none, and that overwrites spanning two clusters,
+   filling in the zero cluster, and growing the file past a hole
+   all read back correctly. */
+
+#include <iostat.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CLUSTER_SIZE 4096
+#define FILE_SIZE 20000
+#define RANDOM_OFS (2 * CLUSTER_SIZE)
+#define ZERO_OFS (3 * CLUSTER_SIZE)
+#define PATCH_OFS 3500
+#define PATCH_SIZE 1100
+#define FILL_OFS (ZERO_OFS + 1000)
+#define FILL_SIZE 500
+#define GROW_OFS 24000
+#define GROW_SIZE 1000
+#define FINAL_SIZE (GROW_OFS + GROW_SIZE)
+
+static char buf[FINAL_SIZE];
+static char buf2[FINAL_SIZE];
+
+/* Writes SIZE bytes of BUF at OFS through FD. */
+static void
+write_at (int fd, size_t ofs, size_t size)
+{
+  seek (fd, ofs);
+  CHECK ((size_t) write (fd, buf + ofs, size) == size,
+         "write %zu bytes at %zu", size, ofs);
+}
+
+void
+test_main (void)
+{
+  struct iostat before, after;
+  int fd, dir_fd, i;
+
+  for (i = 0; i < FILE_SIZE; i++)
+    buf[i] = 'a' + i / 7 % 26;
+  random_init (0);
+  random_bytes (buf + RANDOM_OFS, CLUSTER_SIZE);
+  memset (buf + ZERO_OFS, 0, CLUSTER_SIZE);
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK ((dir_fd = open ("d")) > 1, "open \"d\"");
+  CHECK (!compress (dir_fd), "compress \"d\" (must fail)");
+  msg ("close \"d\"");
+  close (dir_fd);
+  CHECK (!compress (1234), "compress bad fd (must fail)");
+
+  CHECK (create ("data", FILE_SIZE), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (write (fd, buf, FILE_SIZE) == FILE_SIZE, "write \"data\"");
+  CHECK (compress (fd), "compress \"data\"");
+  CHECK (!compress (fd), "compress \"data\" again (must fail)");
+  msg ("close \"data\"");
+  close (fd);
+
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (iostat (IOSTAT_FILESYS, &before), "iostat before reading");
+  seek (fd, ZERO_OFS);
+  CHECK (read (fd, buf2, CLUSTER_SIZE) == CLUSTER_SIZE,
+         "read zero cluster");
+  CHECK (iostat (IOSTAT_FILESYS, &after), "iostat after reading");
+  CHECK (!memcmp (buf + ZERO_OFS, buf2, CLUSTER_SIZE), "compare zeros");
+  CHECK (after.read_cnt == before.read_cnt, "no sectors read from disk");
+
+  CHECK (iostat (IOSTAT_FILESYS, &before), "iostat before reading");
+  seek (fd, 0);
+  CHECK (read (fd, buf2, FILE_SIZE) == FILE_SIZE, "read \"data\"");
+  CHECK (iostat (IOSTAT_FILESYS, &after), "iostat after reading");
+  CHECK (!memcmp (buf, buf2, FILE_SIZE), "compare \"data\"");
+  CHECK (after.read_cnt - before.read_cnt < FILE_SIZE / 512,
+         "read fewer sectors than the file holds");
+
+  memset (buf + PATCH_OFS, 'x', PATCH_SIZE);
+  write_at (fd, PATCH_OFS, PATCH_SIZE);
+  memset (buf + FILL_OFS, 'f', FILL_SIZE);
+  write_at (fd, FILL_OFS, FILL_SIZE);
+  memset (buf + GROW_OFS, 'g', GROW_SIZE);
+  write_at (fd, GROW_OFS, GROW_SIZE);
+  CHECK (filesize (fd) == FINAL_SIZE, "filesize \"data\" is %d", FINAL_SIZE);
+  msg ("close \"data\"");
+  close (fd);
+
+  check_file ("data", buf, FINAL_SIZE);
+}
@@ -0,0 +1,39 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(compress-file) begin
+(compress-file) mkdir "d"
+(compress-file) open "d"
+(compress-file) compress "d" (must fail)
+(compress-file) close "d"
+(compress-file) compress bad fd (must fail)
+(compress-file) create "data"
+(compress-file) open "data"
+(compress-file) write "data"
+(compress-file) compress "data"
+(compress-file) compress "data" again (must fail)
+(compress-file) close "data"
+(compress-file) open "data"
+(compress-file) iostat before reading
+(compress-file) read zero cluster
+(compress-file) iostat after reading
+(compress-file) compare zeros
+(compress-file) no sectors read from disk
+(compress-file) iostat before reading
+(compress-file) read "data"
+(compress-file) iostat after reading
+(compress-file) compare "data"
+(compress-file) read fewer sectors than the file holds
+(compress-file) write 1100 bytes at 3500
+(compress-file) write 500 bytes at 13288
+(compress-file) write 1000 bytes at 24000
+(compress-file) filesize "data" is 25000
+(compress-file) close "data"
+(compress-file) open "data" for verification
+(compress-file) verified contents of "data"
+(compress-file) close "data"
+(compress-file) end
+EOF
+pass;
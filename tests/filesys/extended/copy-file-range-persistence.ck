@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($src) = random_bytes (40000);
+check_archive ({"src" => [$src . substr ($src, 0, 20000)],
+		"dst" => ["\0" x 777 . $src],
+		"d" => {}});
+pass;
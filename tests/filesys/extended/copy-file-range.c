@@ -0,0 +1,77 @@
+/* Copies a file larger than one copy chunk with
+   copy_file_range() into the middle of a shorter file, growing
+   it, then copies the first half of the source onto its own end
+   through a second descriptor.  Checks the positions it leaves
+   behind, that copying at end of file or copying nothing moves
+   nothing, and that bad, console, and directory descriptors are
+   refused. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 40000
+#define DST_OFS 777
+
+static char buf[FILE_SIZE];
+static char src_buf[FILE_SIZE + FILE_SIZE / 2];
+static char dst_buf[DST_OFS + FILE_SIZE];
+
+void
+test_main (void)
+{
+  int src_fd, src_fd2, dst_fd, dir_fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+  memcpy (src_buf, buf, FILE_SIZE);
+  memcpy (src_buf + FILE_SIZE, buf, FILE_SIZE / 2);
+  memcpy (dst_buf + DST_OFS, buf, FILE_SIZE);
+
+  CHECK (create ("src", FILE_SIZE), "create \"src\"");
+  CHECK ((src_fd = open ("src")) > 1, "open \"src\"");
+  CHECK (write (src_fd, buf, FILE_SIZE) == FILE_SIZE, "write \"src\"");
+
+  CHECK (create ("dst", DST_OFS + 100), "create \"dst\"");
+  CHECK ((dst_fd = open ("dst")) > 1, "open \"dst\"");
+  seek (src_fd, 0);
+  seek (dst_fd, DST_OFS);
+  CHECK (copy_file_range (src_fd, dst_fd, FILE_SIZE) == FILE_SIZE,
+         "copy \"src\" into the middle of \"dst\"");
+  CHECK (tell (src_fd) == FILE_SIZE, "tell \"src\"");
+  CHECK (tell (dst_fd) == DST_OFS + FILE_SIZE, "tell \"dst\"");
+  CHECK (filesize (dst_fd) == DST_OFS + FILE_SIZE, "filesize \"dst\"");
+  CHECK (copy_file_range (src_fd, dst_fd, FILE_SIZE) == 0,
+         "copy at end of \"src\"");
+  seek (src_fd, 0);
+  CHECK (copy_file_range (src_fd, dst_fd, 0) == 0, "copy 0 bytes");
+  CHECK (tell (src_fd) == 0 && tell (dst_fd) == DST_OFS + FILE_SIZE,
+         "tell after copying 0 bytes");
+
+  CHECK (copy_file_range (src_fd, 1234, FILE_SIZE) == -1,
+         "copy to bad fd (must fail)");
+  CHECK (copy_file_range (src_fd, 1, FILE_SIZE) == -1,
+         "copy to stdout (must fail)");
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK ((dir_fd = open ("d")) > 1, "open \"d\"");
+  CHECK (copy_file_range (src_fd, dir_fd, FILE_SIZE) == -1,
+         "copy to directory (must fail)");
+  CHECK (copy_file_range (dir_fd, dst_fd, FILE_SIZE) == -1,
+         "copy from directory (must fail)");
+  close (dir_fd);
+  msg ("close \"dst\"");
+  close (dst_fd);
+
+  CHECK ((src_fd2 = open ("src")) > 1, "open \"src\" again");
+  seek (src_fd2, FILE_SIZE);
+  CHECK (copy_file_range (src_fd, src_fd2, FILE_SIZE / 2) == FILE_SIZE / 2,
+         "copy first half of \"src\" onto its end");
+  msg ("close \"src\"");
+  close (src_fd);
+  close (src_fd2);
+
+  check_file ("src", src_buf, sizeof src_buf);
+  check_file ("dst", dst_buf, sizeof dst_buf);
+}
@@ -0,0 +1,37 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-file-range) begin
+(copy-file-range) create "src"
+(copy-file-range) open "src"
+(copy-file-range) write "src"
+(copy-file-range) create "dst"
+(copy-file-range) open "dst"
+(copy-file-range) copy "src" into the middle of "dst"
+(copy-file-range) tell "src"
+(copy-file-range) tell "dst"
+(copy-file-range) filesize "dst"
+(copy-file-range) copy at end of "src"
+(copy-file-range) copy 0 bytes
+(copy-file-range) tell after copying 0 bytes
+(copy-file-range) copy to bad fd (must fail)
+(copy-file-range) copy to stdout (must fail)
+(copy-file-range) mkdir "d"
+(copy-file-range) open "d"
+(copy-file-range) copy to directory (must fail)
+(copy-file-range) copy from directory (must fail)
+(copy-file-range) close "dst"
+(copy-file-range) open "src" again
+(copy-file-range) copy first half of "src" onto its end
+(copy-file-range) close "src"
+(copy-file-range) open "src" for verification
+(copy-file-range) verified contents of "src"
+(copy-file-range) close "src"
+(copy-file-range) open "dst" for verification
+(copy-file-range) verified contents of "dst"
+(copy-file-range) close "dst"
+(copy-file-range) end
+EOF
+pass;
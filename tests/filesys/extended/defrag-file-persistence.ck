@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($frag) = random_bytes (30000);
+substr ($frag, 12345, 2000) = 'x' x 2000;
+check_archive ({"d" => {"frag" => [$frag]}});
+pass;
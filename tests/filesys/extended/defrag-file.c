@@ -0,0 +1,81 @@
+/* Creates a file in a subdirectory whose sectors are scattered
+   over the holes left by deleted files.  Checks that the
+   defragmenter leaves it alone while a clone shares its data,
+   then moves it once the clone is gone, while a descriptor for
+   it stays open and usable for reading and writing.  A second
+   pass must find nothing left to move. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HOLE_CNT 8
+#define FILE_SIZE 30000
+#define PATCH_OFS 12345
+#define PATCH_SIZE 2000
+
+static char buf[FILE_SIZE];
+static char buf2[FILE_SIZE];
+
+void
+test_main (void)
+{
+  char name[16];
+  int fd;
+  int i;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  msg ("leave holes");
+  for (i = 0; i < HOLE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "hole%d", i);
+      if (!create (name, 512))
+        fail ("create \"%s\" failed", name);
+    }
+  for (i = 0; i < HOLE_CNT; i += 2)
+    {
+      snprintf (name, sizeof name, "hole%d", i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (create ("d/frag", FILE_SIZE), "create \"d/frag\"");
+  CHECK ((fd = open ("d/frag")) > 1, "open \"d/frag\"");
+  CHECK (write (fd, buf, FILE_SIZE) == FILE_SIZE, "write \"d/frag\"");
+  msg ("close \"d/frag\"");
+  close (fd);
+
+  CHECK (clone ("d/frag", "d/twin"), "clone \"d/frag\" to \"d/twin\"");
+  CHECK (defrag () == 0, "defragment while \"d/frag\" is shared");
+  check_file ("d/twin", buf, FILE_SIZE);
+  CHECK (remove ("d/twin"), "remove \"d/twin\"");
+
+  CHECK ((fd = open ("d/frag")) > 1, "open \"d/frag\"");
+  CHECK (defrag () > 0, "defragment");
+  CHECK (read (fd, buf2, FILE_SIZE) == FILE_SIZE,
+         "read \"d/frag\" through descriptor opened before moving it");
+  CHECK (!memcmp (buf, buf2, FILE_SIZE), "compare \"d/frag\"");
+  memset (buf + PATCH_OFS, 'x', PATCH_SIZE);
+  seek (fd, PATCH_OFS);
+  CHECK (write (fd, buf + PATCH_OFS, PATCH_SIZE) == PATCH_SIZE,
+         "overwrite part of \"d/frag\"");
+  msg ("close \"d/frag\"");
+  close (fd);
+
+  check_file ("d/frag", buf, FILE_SIZE);
+  CHECK (defrag () == 0, "defragment again");
+
+  msg ("remove remaining holes");
+  for (i = 1; i < HOLE_CNT; i += 2)
+    {
+      snprintf (name, sizeof name, "hole%d", i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+}
@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(defrag-file) begin
+(defrag-file) leave holes
+(defrag-file) mkdir "d"
+(defrag-file) create "d/frag"
+(defrag-file) open "d/frag"
+(defrag-file) write "d/frag"
+(defrag-file) close "d/frag"
+(defrag-file) clone "d/frag" to "d/twin"
+(defrag-file) defragment while "d/frag" is shared
+(defrag-file) open "d/twin" for verification
+(defrag-file) verified contents of "d/twin"
+(defrag-file) close "d/twin"
+(defrag-file) remove "d/twin"
+(defrag-file) open "d/frag"
+(defrag-file) defragment
+(defrag-file) read "d/frag" through descriptor opened before moving it
+(defrag-file) compare "d/frag"
+(defrag-file) overwrite part of "d/frag"
+(defrag-file) close "d/frag"
+(defrag-file) open "d/frag" for verification
+(defrag-file) verified contents of "d/frag"
+(defrag-file) close "d/frag"
+(defrag-file) defragment again
+(defrag-file) remove remaining holes
+(defrag-file) end
+EOF
+pass;
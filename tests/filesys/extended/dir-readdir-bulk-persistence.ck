@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{'dir'}{'sub'} = {};
+$fs->{'dir'}{sprintf ("file%02d", $_)} = ["\0" x ($_ * 100)] foreach 0...19;
+check_archive ($fs);
+pass;
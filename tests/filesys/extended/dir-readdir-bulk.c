@@ -0,0 +1,137 @@
+/* Lists a directory with readdir_bulk() through a buffer that
+   holds only two entries at a time, and checks that every entry
+   is reported exactly once, with its type, size, and inode
+   number, and that ".." is not.  Then checks that readdir() and
+   readdir_bulk() share one position, that types and sizes are
+   left unknown without READDIR_STAT, and that a buffer too small
+   for the next entry or a descriptor for an ordinary file is
+   refused. */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 20
+
+/* Room for two entries named "fileNN", DIRENT_RECLEN (6) bytes
+   each.  DIRENT_RECLEN is not a constant expression, so the size
+   is spelled out. */
+static char buffer[2 * 20];
+static bool seen[FILE_CNT + 1];
+
+/* Returns the index of the entry named NAME in "dir": 0 to
+   FILE_CNT - 1 for "fileNN", FILE_CNT for "sub". */
+static int
+entry_index (const char *name)
+{
+  if (!strcmp (name, "sub"))
+    return FILE_CNT;
+  if (strlen (name) == 6 && !memcmp (name, "file", 4))
+    {
+      int i = atoi (name + 4);
+      if (i >= 0 && i < FILE_CNT)
+        return i;
+    }
+  fail ("unexpected entry \"%s\"", name);
+}
+
+/* Reads the rest of the directory open as FD with readdir_bulk()
+   and FLAGS, marking each entry in SEEN, and returns the number
+   of calls that returned entries. */
+static int
+list_rest (int fd, int flags, int sub_ino)
+{
+  int calls = 0;
+  int size;
+
+  while ((size = readdir_bulk (fd, buffer, sizeof buffer, flags)) > 0)
+    {
+      int ofs;
+
+      calls++;
+      for (ofs = 0; ofs < size; )
+        {
+          struct dirent *d = (struct dirent *) (buffer + ofs);
+          int i = entry_index (d->d_name);
+
+          if (d->d_reclen != DIRENT_RECLEN (d->d_namlen)
+              || strlen (d->d_name) != d->d_namlen)
+            fail ("\"%s\" has bad length", d->d_name);
+          if (seen[i])
+            fail ("\"%s\" reported twice", d->d_name);
+          seen[i] = true;
+
+          if (!(flags & READDIR_STAT))
+            {
+              if (d->d_type != DT_UNKNOWN || d->d_size != -1)
+                fail ("\"%s\" has type %d, size %d without READDIR_STAT",
+                      d->d_name, d->d_type, (int) d->d_size);
+            }
+          else if (i == FILE_CNT)
+            {
+              if (d->d_type != DT_DIR || d->d_ino != sub_ino)
+                fail ("\"sub\" has type %d, inode %d",
+                      d->d_type, (int) d->d_ino);
+            }
+          else if (d->d_type != DT_REG || d->d_size != i * 100)
+            fail ("\"%s\" has type %d, size %d",
+                  d->d_name, d->d_type, (int) d->d_size);
+          ofs += d->d_reclen;
+        }
+    }
+  if (size != 0)
+    fail ("readdir_bulk returned %d", size);
+  return calls;
+}
+
+void
+test_main (void)
+{
+  char name[READDIR_MAX_LEN + 1];
+  int fd, sub_fd, sub_ino, i;
+
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  CHECK (mkdir ("dir/sub"), "mkdir \"dir/sub\"");
+  msg ("create %d files in \"dir\"", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "dir/file%02d", i);
+      if (!create (name, i * 100))
+        fail ("create \"%s\" failed", name);
+    }
+  CHECK ((sub_fd = open ("dir/sub")) > 1, "open \"dir/sub\"");
+  sub_ino = inumber (sub_fd);
+  close (sub_fd);
+
+  CHECK ((fd = open ("dir/file00")) > 1, "open \"dir/file00\"");
+  CHECK (readdir_bulk (fd, buffer, sizeof buffer, READDIR_STAT) == -1,
+         "readdir_bulk on a file (must fail)");
+  close (fd);
+
+  CHECK ((fd = open ("dir")) > 1, "open \"dir\"");
+  CHECK (readdir_bulk (fd, buffer, sizeof (struct dirent), READDIR_STAT) == -1,
+         "readdir_bulk with buffer too small for one entry (must fail)");
+  CHECK (list_rest (fd, READDIR_STAT, sub_ino) >= (FILE_CNT + 1) / 2,
+         "list \"dir\" two entries at a time");
+  for (i = 0; i <= FILE_CNT; i++)
+    if (!seen[i])
+      fail ("entry %d not reported", i);
+  CHECK (readdir_bulk (fd, buffer, sizeof buffer, READDIR_STAT) == 0,
+         "readdir_bulk at end of \"dir\"");
+  close (fd);
+
+  memset (seen, 0, sizeof seen);
+  CHECK ((fd = open ("dir")) > 1, "open \"dir\" again");
+  CHECK (readdir (fd, name), "readdir \"dir\"");
+  seen[entry_index (name)] = true;
+  msg ("list rest of \"dir\" without READDIR_STAT");
+  list_rest (fd, 0, sub_ino);
+  for (i = 0; i <= FILE_CNT; i++)
+    if (!seen[i])
+      fail ("entry %d not reported", i);
+  close (fd);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-readdir-bulk) begin
+(dir-readdir-bulk) mkdir "dir"
+(dir-readdir-bulk) mkdir "dir/sub"
+(dir-readdir-bulk) create 20 files in "dir"
+(dir-readdir-bulk) open "dir/sub"
+(dir-readdir-bulk) open "dir/file00"
+(dir-readdir-bulk) readdir_bulk on a file (must fail)
+(dir-readdir-bulk) open "dir"
+(dir-readdir-bulk) readdir_bulk with buffer too small for one entry (must fail)
+(dir-readdir-bulk) list "dir" two entries at a time
+(dir-readdir-bulk) readdir_bulk at end of "dir"
+(dir-readdir-bulk) open "dir" again
+(dir-readdir-bulk) readdir "dir"
+(dir-readdir-bulk) list rest of "dir" without READDIR_STAT
+(dir-readdir-bulk) end
+EOF
+pass;
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($log) = join ('', map (sprintf ("log record %05d\n", $_), 0...499));
+substr ($log, -5) = 'X' x 5;
+$log .= 'b' x 300;
+$log .= join ('', map (sprintf ("log record %05d\n", $_), 500...999));
+$log .= "\0" x 1000 . "log record 01000\n";
+check_archive ({"log" => [$log]});
+pass;
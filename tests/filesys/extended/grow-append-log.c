@@ -0,0 +1,90 @@
+/* Appends many short records to a file, one write() each, the
+   way a log is written, and checks that the disk sees roughly
+   one write per sector of data rather than one per record.
+   Records are an odd size, so they straddle sector boundaries.
+   Along the way, checks that a second descriptor sees appended
+   data and the new length before they reach the disk, that an
+   overwrite of the buffered tail and an append too big to buffer
+   land in order, and that an append past a hole leaves zeros. */
+
+#include <iostat.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RECORD_CNT 1000
+#define RECORD_SIZE 17
+#define HALF_SIZE (RECORD_CNT / 2 * RECORD_SIZE)
+#define PATCH_SIZE 5
+#define BIG_SIZE 300
+#define HOLE_SIZE 1000
+#define LAST_OFS (HALF_SIZE + BIG_SIZE + HALF_SIZE + HOLE_SIZE)
+#define FILE_SIZE (LAST_OFS + RECORD_SIZE)
+
+static char buf[FILE_SIZE + 1];
+static char buf2[FILE_SIZE];
+
+/* Appends records FIRST up to LAST, formatted at OFS in BUF, to
+   FD, and checks that doing so wrote far fewer sectors than it
+   wrote records. */
+static void
+append_records (int fd, int first, int last, size_t ofs)
+{
+  struct iostat before, after;
+  int i;
+
+  for (i = first; i < last; i++)
+    snprintf (buf + ofs + (i - first) * RECORD_SIZE, RECORD_SIZE + 1,
+              "log record %05d\n", i);
+
+  CHECK (iostat (IOSTAT_FILESYS, &before), "iostat before appending");
+  msg ("append %d records to \"log\"", last - first);
+  for (i = 0; i < last - first; i++)
+    if (write (fd, buf + ofs + i * RECORD_SIZE, RECORD_SIZE) != RECORD_SIZE)
+      fail ("append of record %d failed", first + i);
+  CHECK (iostat (IOSTAT_FILESYS, &after), "iostat after appending");
+  CHECK (after.write_cnt - before.write_cnt < (uint64_t) (last - first) / 4,
+         "far fewer sector writes than records");
+}
+
+void
+test_main (void)
+{
+  int fd, fd2;
+
+  CHECK (create ("log", 0), "create \"log\"");
+  CHECK ((fd = open ("log")) > 1, "open \"log\"");
+  CHECK ((fd2 = open ("log")) > 1, "open \"log\" again");
+
+  append_records (fd, 0, RECORD_CNT / 2, 0);
+  CHECK (filesize (fd2) == HALF_SIZE, "filesize \"log\" is %d", HALF_SIZE);
+  seek (fd2, HALF_SIZE - 100);
+  CHECK (read (fd2, buf2, 200) == 100, "read the last 100 bytes");
+  CHECK (!memcmp (buf + HALF_SIZE - 100, buf2, 100), "compare tail");
+
+  /* Overwrite the end of the last record, then append behind it. */
+  memset (buf + HALF_SIZE - PATCH_SIZE, 'X', PATCH_SIZE);
+  seek (fd2, HALF_SIZE - PATCH_SIZE);
+  CHECK (write (fd2, buf + HALF_SIZE - PATCH_SIZE, PATCH_SIZE) == PATCH_SIZE,
+         "overwrite the last %d bytes", PATCH_SIZE);
+  memset (buf + HALF_SIZE, 'b', BIG_SIZE);
+  CHECK (write (fd, buf + HALF_SIZE, BIG_SIZE) == BIG_SIZE,
+         "append %d bytes", BIG_SIZE);
+
+  append_records (fd, RECORD_CNT / 2, RECORD_CNT, HALF_SIZE + BIG_SIZE);
+
+  /* One more record, past a hole. */
+  memset (buf + LAST_OFS - HOLE_SIZE, 0, HOLE_SIZE);
+  snprintf (buf + LAST_OFS, RECORD_SIZE + 1, "log record %05d\n", RECORD_CNT);
+  seek (fd, LAST_OFS);
+  CHECK (write (fd, buf + LAST_OFS, RECORD_SIZE) == RECORD_SIZE,
+         "append record past a %d-byte hole", HOLE_SIZE);
+  CHECK (filesize (fd2) == FILE_SIZE, "filesize \"log\" is %d", FILE_SIZE);
+  msg ("close \"log\" twice");
+  close (fd);
+  close (fd2);
+
+  check_file ("log", buf, FILE_SIZE);
+}
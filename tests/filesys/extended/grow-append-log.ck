@@ -0,0 +1,31 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-append-log) begin
+(grow-append-log) create "log"
+(grow-append-log) open "log"
+(grow-append-log) open "log" again
+(grow-append-log) iostat before appending
+(grow-append-log) append 500 records to "log"
+(grow-append-log) iostat after appending
+(grow-append-log) far fewer sector writes than records
+(grow-append-log) filesize "log" is 8500
+(grow-append-log) read the last 100 bytes
+(grow-append-log) compare tail
+(grow-append-log) overwrite the last 5 bytes
+(grow-append-log) append 300 bytes
+(grow-append-log) iostat before appending
+(grow-append-log) append 500 records to "log"
+(grow-append-log) iostat after appending
+(grow-append-log) far fewer sector writes than records
+(grow-append-log) append record past a 1000-byte hole
+(grow-append-log) filesize "log" is 18317
+(grow-append-log) close "log" twice
+(grow-append-log) open "log" for verification
+(grow-append-log) verified contents of "log"
+(grow-append-log) close "log"
+(grow-append-log) end
+EOF
+pass;
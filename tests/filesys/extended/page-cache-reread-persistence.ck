@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($data) = random_bytes (10000);
+substr ($data, 4000, 300) = 'p' x 300;
+check_archive ({"data" => [$data . 'g' x 2000]});
+pass;
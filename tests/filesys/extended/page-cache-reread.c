@@ -0,0 +1,95 @@
+/* Checks that reads of a file open through two descriptors are
+   served from the page cache, that writes through either one,
+   including a partial last page and an append that grows it, are
+   seen at once by the other, and that the cache lets go of the
+   file's pages once the last descriptor is closed. */
+
+#include <iostat.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+/* Three pages, the last one partial. */
+#define FILE_SIZE 10000
+#define PATCH_OFS 4000
+#define PATCH_SIZE 300
+#define GROW_SIZE 2000
+
+static char buf[FILE_SIZE + GROW_SIZE];
+static char buf2[FILE_SIZE + GROW_SIZE];
+
+/* Reads SIZE bytes at OFS through FD and checks that they match
+   BUF and that no sectors were read from the disk to get them. */
+static void
+read_cached (int fd, size_t ofs, size_t size, size_t expected)
+{
+  struct iostat before, after;
+
+  memset (buf2, 0, sizeof buf2);
+  seek (fd, ofs);
+  CHECK (iostat (IOSTAT_FILESYS, &before), "iostat before reading");
+  CHECK ((size_t) read (fd, buf2, size) == expected,
+         "read %zu bytes at %zu", expected, ofs);
+  CHECK (iostat (IOSTAT_FILESYS, &after), "iostat after reading");
+  CHECK (!memcmp (buf + ofs, buf2, expected), "compare \"data\"");
+  CHECK (after.read_cnt == before.read_cnt, "no sectors read from disk");
+}
+
+void
+test_main (void)
+{
+  struct iostat before, after;
+  int fd, fd2;
+
+  random_init (0);
+  random_bytes (buf, FILE_SIZE);
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (write (fd, buf, FILE_SIZE) == FILE_SIZE, "write \"data\"");
+  seek (fd, 0);
+  CHECK (read (fd, buf2, FILE_SIZE) == FILE_SIZE, "read \"data\"");
+  CHECK (!memcmp (buf, buf2, FILE_SIZE), "compare \"data\"");
+  CHECK ((fd2 = open ("data")) > 1, "open \"data\" again");
+
+  /* Rereading, through either descriptor, stays in memory. */
+  read_cached (fd, 0, FILE_SIZE, FILE_SIZE);
+  read_cached (fd2, 0, FILE_SIZE, FILE_SIZE);
+
+  /* Reads of the partial last page stop at end of file. */
+  read_cached (fd, FILE_SIZE - 1000, PAGE_SIZE, 1000);
+  CHECK (read (fd, buf2, 1) == 0, "read at end of file");
+
+  /* A write straddling two cached pages is seen by the other
+     descriptor. */
+  memset (buf + PATCH_OFS, 'p', PATCH_SIZE);
+  seek (fd2, PATCH_OFS);
+  CHECK (write (fd2, buf + PATCH_OFS, PATCH_SIZE) == PATCH_SIZE,
+         "write %d bytes at %d", PATCH_SIZE, PATCH_OFS);
+  read_cached (fd, PATCH_OFS - 200, PATCH_SIZE + 400, PATCH_SIZE + 400);
+
+  /* So is an append that fills in the rest of the last page. */
+  memset (buf + FILE_SIZE, 'g', GROW_SIZE);
+  seek (fd2, FILE_SIZE);
+  CHECK (write (fd2, buf + FILE_SIZE, GROW_SIZE) == GROW_SIZE,
+         "append %d bytes", GROW_SIZE);
+  read_cached (fd, 2 * PAGE_SIZE, PAGE_SIZE, FILE_SIZE + GROW_SIZE - 2 * PAGE_SIZE);
+
+  /* Once the file is closed, its pages have to be read again. */
+  msg ("close \"data\" twice");
+  close (fd);
+  close (fd2);
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (iostat (IOSTAT_FILESYS, &before), "iostat before reading");
+  CHECK (read (fd, buf2, sizeof buf2) == sizeof buf2, "read \"data\"");
+  CHECK (iostat (IOSTAT_FILESYS, &after), "iostat after reading");
+  CHECK (!memcmp (buf, buf2, sizeof buf2), "compare \"data\"");
+  CHECK (after.read_cnt > before.read_cnt, "sectors read from disk");
+
+  msg ("close \"data\"");
+  close (fd);
+}
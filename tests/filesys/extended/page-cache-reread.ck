@@ -0,0 +1,51 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-cache-reread) begin
+(page-cache-reread) create "data"
+(page-cache-reread) open "data"
+(page-cache-reread) write "data"
+(page-cache-reread) read "data"
+(page-cache-reread) compare "data"
+(page-cache-reread) open "data" again
+(page-cache-reread) iostat before reading
+(page-cache-reread) read 10000 bytes at 0
+(page-cache-reread) iostat after reading
+(page-cache-reread) compare "data"
+(page-cache-reread) no sectors read from disk
+(page-cache-reread) iostat before reading
+(page-cache-reread) read 10000 bytes at 0
+(page-cache-reread) iostat after reading
+(page-cache-reread) compare "data"
+(page-cache-reread) no sectors read from disk
+(page-cache-reread) iostat before reading
+(page-cache-reread) read 1000 bytes at 9000
+(page-cache-reread) iostat after reading
+(page-cache-reread) compare "data"
+(page-cache-reread) no sectors read from disk
+(page-cache-reread) read at end of file
+(page-cache-reread) write 300 bytes at 4000
+(page-cache-reread) iostat before reading
+(page-cache-reread) read 700 bytes at 3800
+(page-cache-reread) iostat after reading
+(page-cache-reread) compare "data"
+(page-cache-reread) no sectors read from disk
+(page-cache-reread) append 2000 bytes
+(page-cache-reread) iostat before reading
+(page-cache-reread) read 3808 bytes at 8192
+(page-cache-reread) iostat after reading
+(page-cache-reread) compare "data"
+(page-cache-reread) no sectors read from disk
+(page-cache-reread) close "data" twice
+(page-cache-reread) open "data"
+(page-cache-reread) iostat before reading
+(page-cache-reread) read "data"
+(page-cache-reread) iostat after reading
+(page-cache-reread) compare "data"
+(page-cache-reread) sectors read from disk
+(page-cache-reread) close "data"
+(page-cache-reread) end
+EOF
+pass;
@@ -0,0 +1,145 @@
+/* Creates, writes, reads back and removes files and directories
+   under "/tmp", and checks that none of it writes to the file
+   system device.  Also checks that holes in tmpfs files read as
+   zeros, that compress() and clone() refuse tmpfs files, that
+   filling tmpfs either spills to swap or stops short with what
+   was written intact, and that removing a file gives its pages
+   back.  Finally copies a tmpfs file to the disk, where it
+   outlives the reboot that the tmpfs original does not. */
+
+#include <iostat.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 20000
+#define PAGE_SIZE 4096
+#define HOLE_OFS 100000
+#define FILL_PAGES 160
+#define REFILL_PAGES 64
+
+static char buf[FILE_SIZE];
+static char buf2[FILE_SIZE];
+static char page[PAGE_SIZE];
+
+/* Writes up to CNT pages to NAME, page I filled with a letter
+   that depends on I, and returns the number of bytes written. */
+static int
+fill (const char *name, int cnt)
+{
+  int fd, i, size = 0, n;
+
+  CHECK (create (name, 0), "create \"%s\"", name);
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  msg ("write up to %d pages to \"%s\"", cnt, name);
+  for (i = 0; i < cnt; i++)
+    {
+      memset (page, 'a' + i % 26, PAGE_SIZE);
+      n = write (fd, page, PAGE_SIZE);
+      size += n;
+      if (n != PAGE_SIZE)
+        break;
+    }
+  CHECK (filesize (fd) == size, "filesize \"%s\" matches bytes written",
+         name);
+
+  seek (fd, 0);
+  for (i = 0; i * PAGE_SIZE < size; i++)
+    {
+      n = size - i * PAGE_SIZE < PAGE_SIZE ? size - i * PAGE_SIZE : PAGE_SIZE;
+      if (read (fd, buf2, n) != n)
+        fail ("read of page %d of \"%s\" failed", i, name);
+      memset (page, 'a' + i % 26, n);
+      if (memcmp (page, buf2, n))
+        fail ("page %d of \"%s\" differs", i, name);
+    }
+  msg ("verified \"%s\"", name);
+  msg ("close \"%s\"", name);
+  close (fd);
+  return size;
+}
+
+void
+test_main (void)
+{
+  struct iostat before, after;
+  int fd, fd2;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (iostat (IOSTAT_FILESYS, &before), "iostat before");
+  CHECK (create ("/tmp/scratch", 0), "create \"/tmp/scratch\"");
+  CHECK ((fd = open ("/tmp/scratch")) > 1, "open \"/tmp/scratch\"");
+  CHECK (write (fd, buf, FILE_SIZE) == FILE_SIZE, "write \"/tmp/scratch\"");
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"/tmp/scratch\"");
+  seek (fd, 0);
+  CHECK (read (fd, buf2, FILE_SIZE) == FILE_SIZE, "read \"/tmp/scratch\"");
+  CHECK (!memcmp (buf, buf2, FILE_SIZE), "compare \"/tmp/scratch\"");
+  CHECK (!compress (fd), "compress \"/tmp/scratch\" (must fail)");
+  CHECK (!clone ("/tmp/scratch", "/tmp/copy"),
+         "clone \"/tmp/scratch\" to \"/tmp/copy\" (must fail)");
+  msg ("close \"/tmp/scratch\"");
+  close (fd);
+
+  CHECK (create ("/tmp/sparse", 0), "create \"/tmp/sparse\"");
+  CHECK ((fd = open ("/tmp/sparse")) > 1, "open \"/tmp/sparse\"");
+  seek (fd, HOLE_OFS);
+  CHECK (write (fd, "end", 3) == 3, "write 3 bytes at %d", HOLE_OFS);
+  CHECK (filesize (fd) == HOLE_OFS + 3, "filesize \"/tmp/sparse\"");
+  memset (buf2, 'x', PAGE_SIZE);
+  seek (fd, HOLE_OFS / 2);
+  CHECK (read (fd, buf2, PAGE_SIZE) == PAGE_SIZE, "read inside the hole");
+  memset (page, 0, PAGE_SIZE);
+  CHECK (!memcmp (page, buf2, PAGE_SIZE), "hole reads as zeros");
+  msg ("close \"/tmp/sparse\"");
+  close (fd);
+  CHECK (remove ("/tmp/sparse"), "remove \"/tmp/sparse\"");
+
+  CHECK (mkdir ("/tmp/dir"), "mkdir \"/tmp/dir\"");
+  CHECK (chdir ("/tmp/dir"), "chdir \"/tmp/dir\"");
+  CHECK (create ("file", 100), "create \"file\"");
+  CHECK ((fd = open ("../scratch")) > 1, "open \"../scratch\"");
+  CHECK (isdir (open ("../..")) && isdir (open ("/tmp")),
+         "\"/tmp/dir/../..\" and \"/tmp\" are directories");
+  CHECK (read (fd, buf2, FILE_SIZE) == FILE_SIZE, "read \"../scratch\"");
+  CHECK (!memcmp (buf, buf2, FILE_SIZE), "compare \"../scratch\"");
+  CHECK (!remove ("/tmp/dir"), "remove \"/tmp/dir\" (must fail)");
+  CHECK (remove ("file"), "remove \"file\"");
+  CHECK (chdir ("/"), "chdir \"/\"");
+  CHECK (remove ("/tmp/dir"), "remove \"/tmp/dir\"");
+  CHECK (remove ("/tmp/scratch"), "remove \"/tmp/scratch\"");
+  CHECK (read (fd, buf2, 1) == 0, "read removed file at end of file");
+  msg ("close \"../scratch\"");
+  close (fd);
+
+  /* More pages than tmpfs keeps in memory: the rest go to swap if
+     there is any, or else the writes come up short. */
+  fill ("/tmp/big", FILL_PAGES);
+  CHECK (remove ("/tmp/big"), "remove \"/tmp/big\"");
+  CHECK (fill ("/tmp/big", REFILL_PAGES) == REFILL_PAGES * PAGE_SIZE,
+         "all %d pages written after removing \"/tmp/big\"", REFILL_PAGES);
+  CHECK (remove ("/tmp/big"), "remove \"/tmp/big\"");
+  CHECK (iostat (IOSTAT_FILESYS, &after), "iostat after");
+  CHECK (after.write_cnt == before.write_cnt, "no sectors written to disk");
+
+  /* "/tmp/left" is gone after the reboot; "copy" is not. */
+  CHECK (create ("/tmp/left", 0), "create \"/tmp/left\"");
+  CHECK ((fd = open ("/tmp/left")) > 1, "open \"/tmp/left\"");
+  CHECK (write (fd, buf, FILE_SIZE) == FILE_SIZE, "write \"/tmp/left\"");
+  CHECK (!clone ("/tmp/left", "copy"),
+         "clone \"/tmp/left\" to \"copy\" (must fail)");
+  CHECK (create ("copy", 0), "create \"copy\"");
+  CHECK ((fd2 = open ("copy")) > 1, "open \"copy\"");
+  seek (fd, 0);
+  CHECK (copy_file_range (fd, fd2, FILE_SIZE) == FILE_SIZE,
+         "copy \"/tmp/left\" to \"copy\"");
+  msg ("close \"/tmp/left\"");
+  close (fd);
+  msg ("close \"copy\"");
+  close (fd2);
+
+  check_file ("copy", buf, FILE_SIZE);
+}
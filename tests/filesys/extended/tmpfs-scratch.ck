@@ -0,0 +1,70 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(tmpfs-scratch) begin
+(tmpfs-scratch) iostat before
+(tmpfs-scratch) create "/tmp/scratch"
+(tmpfs-scratch) open "/tmp/scratch"
+(tmpfs-scratch) write "/tmp/scratch"
+(tmpfs-scratch) filesize "/tmp/scratch"
+(tmpfs-scratch) read "/tmp/scratch"
+(tmpfs-scratch) compare "/tmp/scratch"
+(tmpfs-scratch) compress "/tmp/scratch" (must fail)
+(tmpfs-scratch) clone "/tmp/scratch" to "/tmp/copy" (must fail)
+(tmpfs-scratch) close "/tmp/scratch"
+(tmpfs-scratch) create "/tmp/sparse"
+(tmpfs-scratch) open "/tmp/sparse"
+(tmpfs-scratch) write 3 bytes at 100000
+(tmpfs-scratch) filesize "/tmp/sparse"
+(tmpfs-scratch) read inside the hole
+(tmpfs-scratch) hole reads as zeros
+(tmpfs-scratch) close "/tmp/sparse"
+(tmpfs-scratch) remove "/tmp/sparse"
+(tmpfs-scratch) mkdir "/tmp/dir"
+(tmpfs-scratch) chdir "/tmp/dir"
+(tmpfs-scratch) create "file"
+(tmpfs-scratch) open "../scratch"
+(tmpfs-scratch) "/tmp/dir/../.." and "/tmp" are directories
+(tmpfs-scratch) read "../scratch"
+(tmpfs-scratch) compare "../scratch"
+(tmpfs-scratch) remove "/tmp/dir" (must fail)
+(tmpfs-scratch) remove "file"
+(tmpfs-scratch) chdir "/"
+(tmpfs-scratch) remove "/tmp/dir"
+(tmpfs-scratch) remove "/tmp/scratch"
+(tmpfs-scratch) read removed file at end of file
+(tmpfs-scratch) close "../scratch"
+(tmpfs-scratch) create "/tmp/big"
+(tmpfs-scratch) open "/tmp/big"
+(tmpfs-scratch) write up to 160 pages to "/tmp/big"
+(tmpfs-scratch) filesize "/tmp/big" matches bytes written
+(tmpfs-scratch) verified "/tmp/big"
+(tmpfs-scratch) close "/tmp/big"
+(tmpfs-scratch) remove "/tmp/big"
+(tmpfs-scratch) create "/tmp/big"
+(tmpfs-scratch) open "/tmp/big"
+(tmpfs-scratch) write up to 64 pages to "/tmp/big"
+(tmpfs-scratch) filesize "/tmp/big" matches bytes written
+(tmpfs-scratch) verified "/tmp/big"
+(tmpfs-scratch) close "/tmp/big"
+(tmpfs-scratch) all 64 pages written after removing "/tmp/big"
+(tmpfs-scratch) remove "/tmp/big"
+(tmpfs-scratch) iostat after
+(tmpfs-scratch) no sectors written to disk
+(tmpfs-scratch) create "/tmp/left"
+(tmpfs-scratch) open "/tmp/left"
+(tmpfs-scratch) write "/tmp/left"
+(tmpfs-scratch) clone "/tmp/left" to "copy" (must fail)
+(tmpfs-scratch) create "copy"
+(tmpfs-scratch) open "copy"
+(tmpfs-scratch) copy "/tmp/left" to "copy"
+(tmpfs-scratch) close "/tmp/left"
+(tmpfs-scratch) close "copy"
+(tmpfs-scratch) open "copy" for verification
+(tmpfs-scratch) verified contents of "copy"
+(tmpfs-scratch) close "copy"
+(tmpfs-scratch) end
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Child process for perf-concurrent.
+   Reads the shared file from start to end, 4 kB at a time, once
+   the parent says go. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/perf/perf-concurrent.h"
+
+const char *test_name = "child-perf-read";
+
+static char buf[4096];
+
+int
+main (int argc, const char *argv[])
+{
+  char ready[32];
+  int child_idx;
+  size_t ofs;
+  int fd, go;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  snprintf (ready, sizeof ready, READY_FMT, child_idx);
+  CHECK (create (ready, 0), "create \"%s\"", ready);
+  while ((go = open (go_name)) == -1)
+    continue;
+  close (go);
+
+  for (ofs = 0; ofs < BUF_SIZE; ofs += sizeof buf)
+    CHECK (read (fd, buf, sizeof buf) == sizeof buf,
+           "read \"%s\" at offset %zu", file_name, ofs);
+  close (fd);
+
+  return child_idx;
+}
@@ -0,0 +1,54 @@
+/* Measures CHILD_CNT processes reading the same file at once.
+   Only the reads are timed: the children are loaded and have the
+   file open before the parent starts the clock and lets them go. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/perf/perf.h"
+#include "tests/filesys/perf/perf-concurrent.h"
+
+#define CHILD_CNT 4
+
+static char buf[BUF_SIZE];
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int status[CHILD_CNT];
+  char workload[32];
+  struct perf p;
+  int fd, i;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  exec_children ("child-perf-read", children, CHILD_CNT);
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      char ready[32];
+
+      snprintf (ready, sizeof ready, READY_FMT, i);
+      while ((fd = open (ready)) == -1)
+        continue;
+      close (fd);
+    }
+
+  perf_start (&p);
+  if (!create (go_name, 0))
+    fail ("create \"%s\"", go_name);
+  for (i = 0; i < CHILD_CNT; i++)
+    status[i] = wait (children[i]);
+  snprintf (workload, sizeof workload, "concurrent-read-%dx%d",
+            CHILD_CNT, BUF_SIZE);
+  perf_report (&p, workload, (size_t) CHILD_CNT * BUF_SIZE);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK (status[i] == i, "wait for child %d of %d returned %d",
+           i + 1, CHILD_CNT, status[i]);
+}
@@ -0,0 +1,13 @@
+#ifndef TESTS_FILESYS_PERF_PERF_CONCURRENT_H
+#define TESTS_FILESYS_PERF_PERF_CONCURRENT_H
+
+#define BUF_SIZE 65536
+static const char file_name[] = "shared";
+
+/* Handshake files, in tmpfs so that they move no sectors: each
+   child creates READY_FMT with its index once it is loaded and
+   has the file open, then starts reading when GO_NAME exists. */
+#define READY_FMT "/tmp/ready-%d"
+static const char go_name[] = "/tmp/go";
+
+#endif /* tests/filesys/perf/perf-concurrent.h */
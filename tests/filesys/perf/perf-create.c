@@ -0,0 +1,68 @@
+/* Measures storms of small files being created and deleted,
+   first empty and then with one sector of data each. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/perf/perf.h"
+
+#define FILE_CNT 10
+#define ROUND_CNT 20
+
+static char buf[512];
+
+/* Creates FILE_CNT files of SIZE bytes, writing their data,
+   then deletes them, ROUND_CNT times over.  Returns the number
+   of bytes written. */
+static size_t
+storm (size_t size)
+{
+  size_t bytes = 0;
+  int round, i;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      char name[16];
+
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          int fd;
+
+          snprintf (name, sizeof name, "f%d", i);
+          if (!create (name, size))
+            fail ("create \"%s\" failed in round %d", name, round);
+          if (size > 0)
+            {
+              if ((fd = open (name)) < 2)
+                fail ("open \"%s\" failed in round %d", name, round);
+              if (write (fd, buf, size) != (int) size)
+                fail ("write \"%s\" failed in round %d", name, round);
+              bytes += size;
+              close (fd);
+            }
+        }
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          snprintf (name, sizeof name, "f%d", i);
+          if (!remove (name))
+            fail ("remove \"%s\" failed in round %d", name, round);
+        }
+    }
+  return bytes;
+}
+
+void
+test_main (void)
+{
+  struct perf p;
+  size_t bytes;
+
+  perf_start (&p);
+  bytes = storm (0);
+  perf_report (&p, "create-delete-empty", bytes);
+
+  perf_start (&p);
+  bytes = storm (sizeof buf);
+  perf_report (&p, "create-delete-512", bytes);
+}
@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::filesys::perf::perf;
+check_perf ("perf-create", qw(create-delete-empty create-delete-512));
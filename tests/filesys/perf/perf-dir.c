@@ -0,0 +1,63 @@
+/* Measures name lookups in a directory filled with as many
+   files as it will take, up to MAX_FILE_CNT, both for names
+   that exist and names that do not. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/perf/perf.h"
+
+#define MAX_FILE_CNT 128
+#define ROUND_CNT 10
+
+void
+test_main (void)
+{
+  char name[16];
+  struct perf p;
+  int file_cnt, round, i;
+
+  /* Fill the directory.  How many entries fit depends on the
+     file system, so stop quietly at the first failure. */
+  for (file_cnt = 0; file_cnt < MAX_FILE_CNT; file_cnt++)
+    {
+      snprintf (name, sizeof name, "d%d", file_cnt);
+      if (!create (name, 0))
+        break;
+    }
+  if (file_cnt == 0)
+    fail ("could not create any files");
+  msg ("filled directory");
+
+  perf_start (&p);
+  for (round = 0; round < ROUND_CNT; round++)
+    for (i = 0; i < file_cnt; i++)
+      {
+        int fd;
+
+        snprintf (name, sizeof name, "d%d", i);
+        if ((fd = open (name)) < 2)
+          fail ("open \"%s\" failed", name);
+        close (fd);
+      }
+  perf_report (&p, "dir-lookup-hit", 0);
+
+  perf_start (&p);
+  for (round = 0; round < ROUND_CNT; round++)
+    for (i = 0; i < file_cnt; i++)
+      {
+        snprintf (name, sizeof name, "x%d", i);
+        if (open (name) != -1)
+          fail ("open \"%s\" succeeded", name);
+      }
+  perf_report (&p, "dir-lookup-miss", 0);
+
+  for (i = 0; i < file_cnt; i++)
+    {
+      snprintf (name, sizeof name, "d%d", i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+  msg ("emptied directory");
+}
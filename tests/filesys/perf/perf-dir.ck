@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::filesys::perf::perf;
+check_perf ("perf-dir", qw(dir-lookup-hit dir-lookup-miss));
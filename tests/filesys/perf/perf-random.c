@@ -0,0 +1,59 @@
+/* Measures writes and reads of several sizes at random offsets
+   within one file. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/perf/perf.h"
+
+#define FILE_SIZE 262144
+#define OP_CNT 256
+
+static char buf[4096];
+
+static const size_t block_sizes[] = {512, 4096};
+
+void
+test_main (void)
+{
+  const char *file_name = "random";
+  size_t i;
+  int fd;
+
+  random_init (0);
+  CHECK (create (file_name, FILE_SIZE), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  for (i = 0; i < sizeof block_sizes / sizeof *block_sizes; i++)
+    {
+      size_t size = block_sizes[i];
+      char workload[32];
+      struct perf p;
+      int op;
+
+      perf_start (&p);
+      for (op = 0; op < OP_CNT; op++)
+        {
+          seek (fd, random_ulong () % (FILE_SIZE - size + 1));
+          if (write (fd, buf, size) != (int) size)
+            fail ("write %zu bytes failed", size);
+        }
+      snprintf (workload, sizeof workload, "random-write-%zu", size);
+      perf_report (&p, workload, size * OP_CNT);
+
+      perf_start (&p);
+      for (op = 0; op < OP_CNT; op++)
+        {
+          seek (fd, random_ulong () % (FILE_SIZE - size + 1));
+          if (read (fd, buf, size) != (int) size)
+            fail ("read %zu bytes failed", size);
+        }
+      snprintf (workload, sizeof workload, "random-read-%zu", size);
+      perf_report (&p, workload, size * OP_CNT);
+    }
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
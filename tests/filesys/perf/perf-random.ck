@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::filesys::perf::perf;
+check_perf ("perf-random", qw(random-write-512 random-read-512
+			      random-write-4096 random-read-4096));
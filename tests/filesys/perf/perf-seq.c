@@ -0,0 +1,78 @@
+/* Measures sequential writes and reads of files of several
+   sizes, 4 kB at a time: overwriting a file created at full size,
+   reading it back, and appending to a file created empty, which
+   allocates its sectors as it grows. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/perf/perf.h"
+
+#define BLOCK_SIZE 4096
+
+static char buf[BLOCK_SIZE];
+
+static const size_t file_sizes[] = {512, 8192, 65536, 524288};
+
+void
+test_main (void)
+{
+  const char *file_name = "seq";
+  size_t i;
+
+  for (i = 0; i < sizeof file_sizes / sizeof *file_sizes; i++)
+    {
+      size_t size = file_sizes[i];
+      char workload[32];
+      struct perf p;
+      size_t ofs;
+      int fd;
+
+      CHECK (create (file_name, size), "create %zu-byte \"%s\"",
+             size, file_name);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+      perf_start (&p);
+      for (ofs = 0; ofs < size; ofs += BLOCK_SIZE)
+        {
+          int chunk = size - ofs < BLOCK_SIZE ? size - ofs : BLOCK_SIZE;
+          if (write (fd, buf, chunk) != chunk)
+            fail ("write %d bytes at offset %zu failed", chunk, ofs);
+        }
+      snprintf (workload, sizeof workload, "seq-write-%zu", size);
+      perf_report (&p, workload, size);
+
+      seek (fd, 0);
+      perf_start (&p);
+      for (ofs = 0; ofs < size; ofs += BLOCK_SIZE)
+        {
+          int chunk = size - ofs < BLOCK_SIZE ? size - ofs : BLOCK_SIZE;
+          if (read (fd, buf, chunk) != chunk)
+            fail ("read %d bytes at offset %zu failed", chunk, ofs);
+        }
+      snprintf (workload, sizeof workload, "seq-read-%zu", size);
+      perf_report (&p, workload, size);
+
+      msg ("close \"%s\"", file_name);
+      close (fd);
+      CHECK (remove (file_name), "remove \"%s\"", file_name);
+
+      CHECK (create (file_name, 0), "create empty \"%s\"", file_name);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+      perf_start (&p);
+      for (ofs = 0; ofs < size; ofs += BLOCK_SIZE)
+        {
+          int chunk = size - ofs < BLOCK_SIZE ? size - ofs : BLOCK_SIZE;
+          if (write (fd, buf, chunk) != chunk)
+            fail ("append %d bytes at offset %zu failed", chunk, ofs);
+        }
+      snprintf (workload, sizeof workload, "seq-append-%zu", size);
+      perf_report (&p, workload, size);
+
+      msg ("close \"%s\"", file_name);
+      close (fd);
+      CHECK (remove (file_name), "remove \"%s\"", file_name);
+    }
+}
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::filesys::perf::perf;
+check_perf ("perf-seq", qw(seq-write-512 seq-read-512 seq-append-512
+			   seq-write-8192 seq-read-8192 seq-append-8192
+			   seq-write-65536 seq-read-65536 seq-append-65536
+			   seq-write-524288 seq-read-524288 seq-append-524288));
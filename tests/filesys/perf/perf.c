@@ -0,0 +1,51 @@
+/* Measurement helpers shared by the file system benchmarks.
+
+   Each workload is reported as one line of KEY=VALUE pairs:
+
+     (perf-seq) PERF workload=seq-read-65536 ticks=3 bytes=65536
+     bytes_per_sec=2184533 reads=128 writes=0 read_reqs=2
+     write_reqs=0 seq_reqs=1 random_reqs=1
+
+   (on a single line) where READS and WRITES count sectors moved
+   to or from the file system device during the workload, and
+   the _REQS values count the requests that moved them.
+   "make perf" collects these lines into build/perf.results. */
+
+#include "tests/filesys/perf/perf.h"
+#include <syscall.h>
+#include "tests/lib.h"
+
+/* Starts measuring a workload. */
+void
+perf_start (struct perf *p)
+{
+  if (!iostat (IOSTAT_FILESYS, &p->start))
+    fail ("iostat failed");
+}
+
+/* Ends the workload started by P, which moved BYTES bytes of
+   file data, and reports it as WORKLOAD.  A workload that
+   finishes within one timer tick is charged a whole tick, so
+   BYTES_PER_SEC is then a lower bound. */
+void
+perf_report (const struct perf *p, const char *workload, size_t bytes)
+{
+  struct iostat end;
+  long long ticks;
+
+  if (!iostat (IOSTAT_FILESYS, &end))
+    fail ("iostat failed");
+  ticks = end.ticks - p->start.ticks;
+
+  msg ("PERF workload=%s ticks=%lld bytes=%zu bytes_per_sec=%lld "
+       "reads=%llu writes=%llu read_reqs=%llu write_reqs=%llu "
+       "seq_reqs=%llu random_reqs=%llu",
+       workload, ticks, bytes,
+       (long long) bytes * end.ticks_per_sec / (ticks > 0 ? ticks : 1),
+       end.read_cnt - p->start.read_cnt,
+       end.write_cnt - p->start.write_cnt,
+       end.read_reqs - p->start.read_reqs,
+       end.write_reqs - p->start.write_reqs,
+       end.seq_reqs - p->start.seq_reqs,
+       end.random_reqs - p->start.random_reqs);
+}
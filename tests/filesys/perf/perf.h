@@ -0,0 +1,17 @@
+#ifndef TESTS_FILESYS_PERF_PERF_H
+#define TESTS_FILESYS_PERF_PERF_H
+
+#include <iostat.h>
+#include <stddef.h>
+
+/* A measurement in progress: file system device statistics
+   sampled when it started. */
+struct perf
+  {
+    struct iostat start;
+  };
+
+void perf_start (struct perf *);
+void perf_report (const struct perf *, const char *workload, size_t bytes);
+
+#endif /* tests/filesys/perf/perf.h */
@@ -0,0 +1,34 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# Checks that benchmark $test_name ran to completion and reported
+# each of @workloads on a well-formed PERF line.  The numbers
+# themselves are not checked.
+sub check_perf {
+    my ($test_name, @workloads) = @_;
+    our ($test);
+    my (@output) = read_text_file ("$test.output");
+
+    common_checks ("run", @output);
+    @output = get_core_output ("run", @output);
+    fail "First line of output is not `($test_name) begin' message.\n"
+      if $output[0] ne "($test_name) begin";
+    fail "Output missing `($test_name) end' message.\n"
+      if !grep ("($test_name) end" eq $_, @output);
+
+    my (%seen);
+    foreach (@output) {
+	next if !/^\(\Q$test_name\E\) PERF /;
+	fail "Malformed PERF line: $_\n"
+	  if !/^\(\Q$test_name\E\) PERF workload=(\S+) ticks=\d+ bytes=\d+ bytes_per_sec=\d+ reads=\d+ writes=\d+ read_reqs=\d+ write_reqs=\d+ seq_reqs=\d+ random_reqs=\d+$/;
+	$seen{$1} = 1;
+    }
+    foreach my $workload (@workloads) {
+	fail "No PERF line for workload $workload.\n" if !$seen{$workload};
+    }
+    pass;
+}
+
+1;
@@ -0,0 +1,20 @@
+/* Passes readdir_bulk() a buffer whose first and last bytes are
+   valid but which spans unmapped pages in between.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/userprog/boundary.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char last;
+  char *first = get_boundary_area ();
+  int handle;
+
+  CHECK ((handle = open ("/")) > 1, "open \"/\"");
+  readdir_bulk (handle, first, &last - first + 1, 0);
+  fail ("should not have survived readdir_bulk()");
+}
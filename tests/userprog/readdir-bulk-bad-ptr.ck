@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readdir-bulk-bad-ptr) begin
+(readdir-bulk-bad-ptr) open "/"
+readdir-bulk-bad-ptr: exit(-1)
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Passes readdir_bulk() a buffer in the code segment, which is
+   mapped but read-only.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle;
+
+  CHECK ((handle = open ("/")) > 1, "open \"/\"");
+  readdir_bulk (handle, (void *) test_main, 64, 0);
+  fail ("survived reading directory entries into code segment");
+}
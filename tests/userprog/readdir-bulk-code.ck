@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readdir-bulk-code) begin
+(readdir-bulk-code) open "/"
+readdir-bulk-code: exit(-1)
+EOF
+pass;
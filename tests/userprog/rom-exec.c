@@ -0,0 +1,20 @@
+/* Runs from the boot image that "pintos --rom" packs the test
+   programs into, and executes a child program from it.  Neither
+   program is copied into the file system. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle;
+
+  CHECK (open ("child-simple") == -1,
+         "\"child-simple\" is not in the file system");
+  CHECK ((handle = open ("/rom/child-simple")) > 1,
+         "open \"/rom/child-simple\"");
+  close (handle);
+  wait (exec ("child-simple"));
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rom-exec) begin
+(rom-exec) "child-simple" is not in the file system
+(rom-exec) open "/rom/child-simple"
+(child-simple) run
+child-simple: exit(81)
+(rom-exec) end
+rom-exec: exit(0)
+EOF
+pass;
@@ -0,0 +1,24 @@
+/* Creates a file in the file system with the same name as a
+   program in the boot image, then executes that name.  The boot
+   image is searched first, so the program runs, not the file,
+   which does not hold a program at all. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char junk[] = "not a program";
+
+void
+test_main (void) 
+{
+  int handle;
+
+  CHECK (create ("child-simple", 0), "create \"child-simple\"");
+  CHECK ((handle = open ("child-simple")) > 1, "open \"child-simple\"");
+  CHECK (write (handle, junk, sizeof junk) == sizeof junk,
+         "write \"child-simple\"");
+  close (handle);
+  CHECK (wait (exec ("child-simple")) == 81,
+         "exec \"child-simple\" from the boot image");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rom-shadow) begin
+(rom-shadow) create "child-simple"
+(rom-shadow) open "child-simple"
+(rom-shadow) write "child-simple"
+(rom-shadow) exec "child-simple" from the boot image
+(child-simple) run
+child-simple: exit(81)
+(rom-shadow) end
+rom-shadow: exit(0)
+EOF
+pass;
@@ -0,0 +1,44 @@
+/* Forks, then has the child overwrite a buffer that the two
+   processes share copy-on-write, and checks that each process
+   sees only its own writes. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+  pid_t pid;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = i * 257;
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      for (i = 0; i < sizeof buf; i++)
+        if (buf[i] != (char) (i * 257))
+          fail ("child sees byte %zu as %d before writing", i, buf[i]);
+      for (i = 0; i < sizeof buf; i++)
+        buf[i] = 'x';
+      for (i = 0; i < sizeof buf; i++)
+        if (buf[i] != 'x')
+          fail ("child's write to byte %zu was lost", i);
+      msg ("child wrote buffer");
+      exit (0);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+
+  wait (pid);
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (char) (i * 257))
+      fail ("parent sees byte %zu as %d after child wrote it", i, buf[i]);
+  msg ("parent's buffer intact");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-cow) begin
+(fork-cow) child wrote buffer
+(fork-cow) parent's buffer intact
+(fork-cow) end
+EOF
+pass;
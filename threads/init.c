@@ -50,6 +50,9 @@ uint32_t *init_page_dir;
 /* -f: Format the file system? */
 static bool format_filesys;
 
+/* -fbs: Block size to format the file system with. */
+static size_t format_block_size = BLOCK_SECTOR_SIZE;
+
 /* -filesys, -scratch, -swap: Names of block devices to use,
    overriding the defaults. */
 static const char *filesys_bdev_name;
@@ -129,7 +132,7 @@ main (void)
   /* Initialize file system. */
   ide_init ();
   locate_block_devices ();
-  filesys_init (format_filesys);
+  filesys_init (format_filesys, format_block_size);
 #endif
 
 #ifdef VM
@@ -255,6 +258,8 @@ parse_options (char **argv)
 #ifdef FILESYS
       else if (!strcmp (name, "-f"))
         format_filesys = true;
+      else if (!strcmp (name, "-fbs"))
+        format_block_size = atoi (value);
       else if (!strcmp (name, "-filesys"))
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
@@ -327,6 +332,7 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"defrag", 1, fsutil_defrag},
 #endif
       {NULL, 0, NULL},
     };
@@ -376,6 +382,7 @@ usage (void)
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
+          "  defrag             Make fragmented files contiguous.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
@@ -383,6 +390,7 @@ usage (void)
           "  -r                 Reboot after actions.\n"
 #ifdef FILESYS
           "  -f                 Format file system device during startup.\n"
+          "  -fbs=BYTES         Format with BYTES-byte blocks (512 to 4096).\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -31,6 +32,7 @@ struct pool
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t free_cnt;                    /* Number of free pages. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +41,7 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void adjust_free_cnt (struct pool *, int delta);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -79,6 +82,8 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 
   lock_acquire (&pool->lock);
   page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  if (page_idx != BITMAP_ERROR)
+    adjust_free_cnt (pool, -(int) page_cnt);
   lock_release (&pool->lock);
 
   if (page_idx != BITMAP_ERROR)
@@ -139,6 +144,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  adjust_free_cnt (pool, page_cnt);
 }
 
 /* Frees the page at PAGE. */
@@ -148,6 +154,25 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the address of the first page in the user pool and
+   stores the number of pages in it in *PAGE_CNT, so that a
+   table with one entry per user page can be indexed by
+   (page - base) / PGSIZE. */
+void *
+palloc_user_pool (size_t *page_cnt)
+{
+  *page_cnt = bitmap_size (user_pool.used_map);
+  return user_pool.base;
+}
+
+/* Returns the number of free pages in the user pool.  The answer
+   may be out of date by the time the caller looks at it. */
+size_t
+palloc_user_free_cnt (void)
+{
+  return user_pool.free_cnt;
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -167,6 +192,18 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   lock_init (&p->lock);
   p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
   p->base = base + bm_pages * PGSIZE;
+  p->free_cnt = page_cnt;
+}
+
+/* Adds DELTA to POOL's count of free pages.  Pages are freed
+   without the pool lock, even from the scheduler, so the count is
+   updated with interrupts off instead. */
+static void
+adjust_free_cnt (struct pool *pool, int delta)
+{
+  enum intr_level old_level = intr_disable ();
+  pool->free_cnt += delta;
+  intr_set_level (old_level);
 }
 
 /* Returns true if PAGE was allocated from POOL,
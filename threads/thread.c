@@ -14,6 +14,9 @@
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
+#ifdef FILESYS
+#include "filesys/directory.h"
+#endif
 
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
@@ -183,6 +186,11 @@ thread_create (const char *name, int priority,
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+#ifdef FILESYS
+  /* Start out in the creator's working directory. */
+  if (thread_current ()->cwd != NULL)
+    t->cwd = dir_reopen (thread_current ()->cwd);
+#endif
 
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack'
@@ -309,6 +317,10 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+#ifdef FILESYS
+  dir_close (thread_current ()->cwd);
+  thread_current ()->cwd = NULL;
+#endif
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
@@ -108,6 +108,16 @@ struct thread
 
 #ifdef VM
     struct hash s_pte;
+    void *swap_hint_page;               /* Page last evicted to swap, */
+    size_t swap_hint_slot;              /* and the slot it went to. */
+    void *user_esp;                     /* User stack pointer at the
+                                           current system call. */
+#endif
+
+#ifdef FILESYS
+    /* Owned by filesys/filesys.c. */
+    struct dir *cwd;                    /* Working directory, or null
+                                           for the root directory. */
 #endif
 
     /* Owned by thread.c. */
@@ -147,6 +147,12 @@ static void page_fault (struct intr_frame *f) {
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  // Writes to pages shared copy-on-write after fork() fault too.
+  if (!not_present && write && vm_cow_fault(fault_addr))
+    return;
+#endif
+
   // @3.1.4.1 Typical Memory Layout
  // printf("Code segment: %x\n", f->cs);
   if (fault_addr == NULL                        ||
@@ -237,13 +243,13 @@ In page fault
   struct sPageTableEntry *spte = page_lookup(pg_round_down(fault_addr), &t->s_pte);
   if (!spte && ((f->esp - 32) <= fault_addr) /* && (fault_addr <= (f->esp + 4))*/) {
     //printf("Growing Stack\n");
-    vm_grow_stack(fault_addr);
+    vm_grow_stack(fault_addr, write);
     return ;
   } else if (spte) {
     // printf("\n\nstruct sPageTableEntry {\n\tuint32_t *user_vaddr = %x\n\tuint8_t location = %d\n\tstruct file *file = %x\n\toff_t file_offset = %d\n\tsize_t disk_offset = %d\n\tdirty = %d\n};\n\n",
     // spte->user_vaddr, spte->location, spte->file, spte->file_offset, spte->disk_offset, spte->dirty);
 
-    vm_load_install(fault_addr, spte);
+    vm_load_install(fault_addr, spte, write);
     return ;
   } else {
     // printf("(f->esp - 32): %d <= fault_addr: %d\n", (f->esp - 32), fault_addr);
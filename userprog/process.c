@@ -129,6 +129,74 @@ static void start_process (void *file_name_) {
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* What process_fork() hands the child it creates. */
+struct fork_args
+  {
+    struct thread *parent;
+    struct intr_frame if_;              /* Parent's user context. */
+    struct semaphore done;              /* Upped once the child is set up. */
+    bool success;                       /* Whether it could be. */
+  };
+
+/* A thread function that makes itself a copy of the forking
+   process and returns to user mode where it left off. */
+static void start_fork (void *args_) {
+  struct fork_args *args = args_;
+  struct thread *cur = thread_current ();
+  struct thread *parent = args->parent;
+  struct intr_frame if_ = args->if_;
+  bool success;
+
+  cur->parentID = parent->tid;
+  hash_init (&cur->s_pte, &page_hash, &page_less, NULL);
+  cur->pagedir = pagedir_create ();
+  success = (cur->pagedir != NULL
+             && vm_fork (parent, cur)
+             && syscall_fork (parent, cur));
+  process_activate ();
+
+  /* ARGS lives on the parent's stack, which may be gone once the
+     parent is released. */
+  args->success = success;
+  sema_up (&args->done);
+  if (!success)
+    thread_exit ();
+
+  /* The child sees fork() return 0. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
+/* Starts a new process that is a copy of the current one and
+   resumes from F, the current process's system call frame, but
+   with fork() returning 0.  Rather than loading a program, the
+   child shares the parent's pages copy-on-write.  Returns the
+   child's thread id, or TID_ERROR if it cannot be created. */
+tid_t process_fork (const struct intr_frame *f UNUSED) {
+#ifdef VM
+  struct fork_args args;
+  tid_t tid;
+
+  args.parent = thread_current ();
+  args.if_ = *f;
+  sema_init (&args.done, 0);
+  args.success = false;
+
+  tid = thread_create (thread_name (), PRI_DEFAULT, start_fork, &args);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  sema_down (&args.done);
+  return args.success ? tid : TID_ERROR;
+#else
+  /* Without copy-on-write paging, fork() would mean copying every
+     page up front. */
+  return TID_ERROR;
+#endif
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -165,6 +233,7 @@ void process_exit (void) {
   if (pd != NULL) {
     #ifdef VM
       mmap_write_back_on_shutdown();
+      vm_free_thread_frames(cur);
     #endif
       // TODO: unmap mmapped pages
       /* Correct ordering here is crucial.  We must set
@@ -297,7 +366,7 @@ bool load (const char *file_name, void (**eip) (void), void **esp) {
 
   token = strtok_r(file_n, " ", &save_ptr);
 
-  file = filesys_open (token);
+  file = filesys_open_exec (token);
   if (file == NULL) {
       printf ("load: %s: open failed\n", file_name);
       goto done;
@@ -519,7 +588,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes,
 
       if (page_lookup(upage, &t->s_pte) == NULL) {
 
-        struct sPageTableEntry *spte = getCustomSupPTE((uint32_t *)upage, LOC_MMAP, file, file_tell(file), page_read_bytes, 0);
+        /* Pages wholly past the end of the segment's file data, as in
+           BSS, need nothing from the file. */
+        struct sPageTableEntry *spte;
+        if (page_read_bytes == 0)
+          spte = getSupPTE ((uint32_t *)upage);
+        else
+          spte = getCustomSupPTE((uint32_t *)upage, LOC_MMAP | LOC_EXEC, file, file_tell(file), page_read_bytes, 0);
+        spte->writable = writable;
         // printf("Process Load: user_vaddr: %x\n", spte->user_vaddr);
         hash_insert(&t->s_pte, &spte->hash_elem);
       } else {
@@ -1,3 +1,4 @@
+#include <iostat.h>
 #include <stdio.h>
 #include <string.h>
 #include <syscall-nr.h>
@@ -12,8 +13,12 @@
 #include "userprog/syscall.h"
 #include "devices/shutdown.h"
 #include "devices/input.h"
+#include "devices/block.h"
+#include "devices/timer.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
 
 
 #ifdef VM
@@ -33,6 +38,7 @@ struct returnStatus {
 struct fileDescriptor {
   int fd;
   struct file *file;
+  struct dir *dir;              /* non-NULL if file is a directory */
   struct thread *t;
   struct mmap_file *mmap;
   struct list_elem globalFDList;
@@ -68,6 +74,7 @@ static void syscall_handler (struct intr_frame *);
 
 
 static bool isValidAddr(uint32_t *);
+static bool isValidBuffer(void *, unsigned);
 static bool create(uint32_t *args);
 static int write(uint32_t *args);
 static int open(uint32_t *args);
@@ -81,6 +88,18 @@ static bool remove(uint32_t *args);
 static void exit(uint32_t *args);
 static pid_t exec (uint32_t *args);
 static void halt(void);
+static bool chdir(uint32_t *args);
+static bool mkdir(uint32_t *args);
+static bool readdir(uint32_t *args);
+static bool isdir(uint32_t *args);
+static int inumber(uint32_t *args);
+static int readdir_bulk(uint32_t *args);
+static bool iostat(uint32_t *args);
+static int defrag(void);
+static bool clone(uint32_t *args);
+static int copy_file_range(uint32_t *args);
+static bool compress(uint32_t *args);
+static pid_t sys_fork(struct intr_frame *f);
 
 #ifdef VM
 static mapid_t mmap(uint32_t *args);
@@ -114,6 +133,9 @@ static void syscall_handler (struct intr_frame *f UNUSED) {
     printf("%s: exit(-1)\n", cur->name);
     thread_exit();
   }
+#ifdef VM
+  thread_current()->user_esp = f->esp;
+#endif
 
   if (*args == SYS_HALT) {
     halt();
@@ -142,6 +164,30 @@ static void syscall_handler (struct intr_frame *f UNUSED) {
     f->eax = tell(args);
   } else if (*args == SYS_CLOSE) {
     close(args);
+  } else if (*args == SYS_CHDIR) {
+    f->eax = chdir(args);
+  } else if (*args == SYS_MKDIR) {
+    f->eax = mkdir(args);
+  } else if (*args == SYS_READDIR) {
+    f->eax = readdir(args);
+  } else if (*args == SYS_ISDIR) {
+    f->eax = isdir(args);
+  } else if (*args == SYS_INUMBER) {
+    f->eax = inumber(args);
+  } else if (*args == SYS_READDIR_BULK) {
+    f->eax = readdir_bulk(args);
+  } else if (*args == SYS_IOSTAT) {
+    f->eax = iostat(args);
+  } else if (*args == SYS_DEFRAG) {
+    f->eax = defrag();
+  } else if (*args == SYS_CLONE) {
+    f->eax = clone(args);
+  } else if (*args == SYS_COPY_FILE_RANGE) {
+    f->eax = copy_file_range(args);
+  } else if (*args == SYS_COMPRESS) {
+    f->eax = compress(args);
+  } else if (*args == SYS_FORK) {
+    f->eax = sys_fork(f);
   }
 #ifdef VM
   else if (*args == SYS_MMAP) {
@@ -168,6 +214,76 @@ static pid_t exec (uint32_t *args) {
 }
 
 
+// pid_t fork (void);
+static pid_t sys_fork(struct intr_frame *f) {
+  return process_fork(f);
+}
+
+// Gives CHILD copies of PARENT's file descriptors and memory mappings,
+// for fork(). Each descriptor gets its own struct file, and struct dir
+// if it is a directory, at the same positions as the parent's. Returns
+// false if out of memory.
+bool syscall_fork(struct thread *parent, struct thread *child) {
+  struct list_elem *iter;
+  bool success = true;
+
+  lock_acquire(&fileSystemLock);
+  child->lowestOpenFD = parent->lowestOpenFD;
+  for (iter = list_begin(&parent->fdList); iter != list_end(&parent->fdList); iter = list_next(iter)) {
+    struct fileDescriptor *pfd = list_entry(iter, struct fileDescriptor, threadFDList);
+    struct fileDescriptor *cfd = malloc(sizeof(struct fileDescriptor));
+
+    if (cfd == NULL || (cfd->file = file_reopen(pfd->file)) == NULL) {
+      free(cfd);
+      success = false;
+      break;
+    }
+    cfd->dir = NULL;
+    if (pfd->dir != NULL && (cfd->dir = dir_reopen(pfd->dir)) == NULL) {
+      file_close(cfd->file);
+      free(cfd);
+      success = false;
+      break;
+    }
+    file_seek(cfd->file, file_tell(pfd->file));
+    if (cfd->dir != NULL)
+      dir_seek(cfd->dir, dir_tell(pfd->dir));
+    cfd->fd = pfd->fd;
+    cfd->t = child;
+    cfd->mmap = NULL;
+    list_push_back(&child->fdList, &cfd->threadFDList);
+    list_push_back(&FD, &cfd->globalFDList);
+  }
+
+#ifdef VM
+  // The pages themselves were copied by vm_fork().
+  struct list copies;
+  list_init(&copies);
+  lock_acquire(&_mmapLock);
+  for (iter = list_begin(&_mmapList); success && iter != list_end(&_mmapList); iter = list_next(iter)) {
+    struct mmap_file *m = list_entry(iter, struct mmap_file, elem);
+    struct mmap_file *copy;
+
+    if (m->owner != parent)
+      continue;
+    copy = malloc(sizeof(struct mmap_file));
+    if (copy == NULL) {
+      success = false;
+      break;
+    }
+    *copy = *m;
+    copy->owner = child;
+    list_push_back(&copies, &copy->elem);
+  }
+  while (!list_empty(&copies))
+    list_push_back(&_mmapList, list_pop_front(&copies));
+  lock_release(&_mmapLock);
+#endif
+
+  lock_release(&fileSystemLock);
+  return success;
+}
+
 static bool remove(uint32_t *args) { //bool remove (const char *file);
   if (!isValidAddr((void *) args[1]) || args == NULL) {
     exit(NULL);
@@ -251,6 +367,11 @@ static int write(uint32_t *args) {
       lock_release(&fileSystemLock);
       return 0;
     }
+    // directories can't be written with write()
+    if (s_fd->dir != NULL) {
+      lock_release(&fileSystemLock);
+      return -1;
+    }
     // write to file
     if (s_fd->mmap == NULL) {
       size = file_write(s_fd->file, buffer, size);
@@ -278,12 +399,17 @@ static int write(uint32_t *args) {
   if (fd == 1) {
     putbuf(buffer, size);
   } else {
-    struct file* file = getFileFromFD(fd, thread_current());
-    if (file == NULL) {
+    struct fileDescriptor *s_fd = getFD(fd, thread_current());
+    if (s_fd == NULL) {
       lock_release(&fileSystemLock);
       return 0;
     }
-    size = file_write(file, buffer, size);
+    // directories can't be written with write()
+    if (s_fd->dir != NULL) {
+      lock_release(&fileSystemLock);
+      return -1;
+    }
+    size = file_write(s_fd->file, buffer, size);
   }
 #endif
   lock_release(&fileSystemLock);
@@ -300,6 +426,7 @@ static void close(uint32_t *args) {
   lock_acquire(&fileSystemLock);
 
   if (closeHelperThread(closeFD, &t->fdList, t) && (fdStruct = closeHelperGlobal(closeFD, &FD, t)) != NULL) {
+    dir_close(fdStruct->dir);
     file_close(fdStruct->file);
     //if (fdStruct->fd < t->lowestOpenFD)
     //  t->lowestOpenFD = fdStruct->fd;
@@ -330,8 +457,12 @@ static int open(uint32_t *args) {
     fileDesc->t = t;
     fileDesc->fd = setFD;
     fileDesc->file = f;
+    fileDesc->dir = NULL;
     fileDesc->mmap = NULL;
 
+    if (inode_is_dir(file_get_inode(f)))
+      fileDesc->dir = dir_open(inode_reopen(file_get_inode(f)));
+
     //implicitly protected
     list_push_back(&t->fdList, &fileDesc->threadFDList);
     list_push_back(&FD ,&fileDesc->globalFDList);
@@ -486,6 +617,195 @@ static int read(uint32_t *args) {
 }
 
 
+// bool chdir (const char *dir);
+static bool chdir(uint32_t *args) {
+  const char *dir = (const char *) args[1];
+
+  if (!isValidAddr((void *) dir)) {
+    exit(NULL);
+    thread_exit();
+  }
+
+  lock_acquire(&fileSystemLock);
+  bool result = filesys_chdir(dir);
+  lock_release(&fileSystemLock);
+
+  return result;
+}
+
+// bool mkdir (const char *dir);
+static bool mkdir(uint32_t *args) {
+  const char *dir = (const char *) args[1];
+
+  if (!isValidAddr((void *) dir)) {
+    exit(NULL);
+    thread_exit();
+  }
+
+  lock_acquire(&fileSystemLock);
+  bool result = filesys_mkdir(dir);
+  lock_release(&fileSystemLock);
+
+  return result;
+}
+
+// bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
+// "." and ".." are never returned.
+static bool readdir(uint32_t *args) {
+  int fd = (int) args[1];
+  char *name = (char *) args[2];
+  bool result = false;
+
+  if (!isValidAddr((void *) name) || !isValidAddr((void *) (name + NAME_MAX))) {
+    exit(NULL);
+    thread_exit();
+  }
+
+  lock_acquire(&fileSystemLock);
+  struct fileDescriptor *s_fd = getFD(fd, thread_current());
+  if (s_fd != NULL && s_fd->dir != NULL)
+    result = dir_readdir(s_fd->dir, name);
+  lock_release(&fileSystemLock);
+
+  return result;
+}
+
+static bool isdir(uint32_t *args) {
+  int fd = (int) args[1];
+  bool result = false;
+
+  lock_acquire(&fileSystemLock);
+  struct fileDescriptor *s_fd = getFD(fd, thread_current());
+  if (s_fd != NULL)
+    result = s_fd->dir != NULL;
+  lock_release(&fileSystemLock);
+
+  return result;
+}
+
+static int inumber(uint32_t *args) {
+  int fd = (int) args[1];
+  int inumber = -1;
+
+  lock_acquire(&fileSystemLock);
+  struct file *fp = getFileFromFD(fd, thread_current());
+  if (fp != NULL)
+    inumber = inode_get_inumber(file_get_inode(fp));
+  lock_release(&fileSystemLock);
+
+  return inumber;
+}
+
+// int readdir_bulk (int fd, void *buffer, unsigned size, int flags);
+// Packs as many directory entries as fit into BUFFER in one trap.
+static int readdir_bulk(uint32_t *args) {
+  int fd = (int) args[1];
+  void *buffer = (void *) args[2];
+  unsigned size = (unsigned) args[3];
+  int flags = (int) args[4];
+  int bytes = -1;
+
+  if (!isValidBuffer(buffer, size)) {
+    exit(NULL);
+    thread_exit();
+  }
+
+  lock_acquire(&fileSystemLock);
+  struct fileDescriptor *s_fd = getFD(fd, thread_current());
+  if (s_fd != NULL && s_fd->dir != NULL)
+    bytes = dir_readdir_bulk(s_fd->dir, buffer, size, flags);
+  lock_release(&fileSystemLock);
+
+  return bytes;
+}
+
+static bool iostat(uint32_t *args) {
+  int device = (int) args[1];
+  struct iostat *st = (struct iostat *) args[2];
+  struct block *block;
+
+  if (!isValidBuffer(st, sizeof *st)) {
+    exit(NULL);
+    thread_exit();
+  }
+
+  if (device < 0 || device >= BLOCK_ROLE_CNT)
+    return false;
+  block = block_get_role(device);
+  if (block == NULL)
+    return false;
+
+  block_get_stats(block, st);
+  st->ticks = timer_ticks();
+  st->ticks_per_sec = TIMER_FREQ;
+  return true;
+}
+
+static int defrag(void) {
+  int moved;
+
+  lock_acquire(&fileSystemLock);
+  moved = filesys_defrag();
+  lock_release(&fileSystemLock);
+
+  return moved;
+}
+
+static bool clone(uint32_t *args) {
+  const char *src = (const char *) args[1];
+  const char *dst = (const char *) args[2];
+
+  if (!isValidAddr((void *) src) || !isValidAddr((void *) dst)) {
+    exit(NULL);
+    thread_exit();
+  }
+
+  lock_acquire(&fileSystemLock);
+  bool result = filesys_clone(src, dst);
+  lock_release(&fileSystemLock);
+
+  return result;
+}
+
+// int copy_file_range (int fd_in, int fd_out, unsigned size);
+// Copies from fd_in's position to fd_out's without the data ever
+// passing through user memory.
+static int copy_file_range(uint32_t *args) {
+  int fd_in = (int) args[1];
+  int fd_out = (int) args[2];
+  unsigned size = (unsigned) args[3];
+  int bytes = -1;
+
+  if (fd_in < 2 || fd_out < 2)
+    return -1;
+  if (size > INT32_MAX)
+    size = INT32_MAX;
+
+  lock_acquire(&fileSystemLock);
+  struct fileDescriptor *in = getFD(fd_in, thread_current());
+  struct fileDescriptor *out = getFD(fd_out, thread_current());
+  if (in != NULL && out != NULL && in->dir == NULL && out->dir == NULL)
+    bytes = file_copy(out->file, in->file, size);
+  lock_release(&fileSystemLock);
+
+  return bytes;
+}
+
+// bool compress (int fd);
+// Stores the file's data compressed from now on.
+static bool compress(uint32_t *args) {
+  int fd = (int) args[1];
+  bool result = false;
+
+  lock_acquire(&fileSystemLock);
+  struct fileDescriptor *s_fd = getFD(fd, thread_current());
+  if (s_fd != NULL && s_fd->dir == NULL && s_fd->file != NULL)
+    result = inode_compress(file_get_inode(s_fd->file));
+  lock_release(&fileSystemLock);
+
+  return result;
+}
+
 static int filesize (uint32_t *args) {
   int fd = (int) args[1];
   int fileSize = 0;
@@ -684,6 +1004,41 @@ static bool isValidAddr(uint32_t *vaddr) {
   return vaddr != NULL && is_user_vaddr(vaddr) && pagedir_get_page(cur->pagedir,(void *) vaddr);
 }
 
+// Returns true if every page of the SIZE bytes at BUFFER is mapped, or
+// with VM will be on first touch, and may be written by the process, so
+// that a fault while the kernel fills them in cannot kill the process
+// with locks held.
+static bool isValidBuffer(void *buffer, unsigned size) {
+  struct thread *cur = thread_current();
+  uint8_t *end = (uint8_t *) buffer + (size > 0 ? size : 1);
+  uint8_t *page;
+
+  if (buffer == NULL || end < (uint8_t *) buffer)
+    return false;
+  for (page = pg_round_down(buffer); page < end; page += PGSIZE) {
+#ifdef VM
+    // Copy-on-write and zero-fill pages are mapped read-only until the
+    // first write, so ask the SPTE.
+    struct sPageTableEntry *spte = is_user_vaddr(page) ? page_lookup(page, &cur->s_pte) : NULL;
+    if (spte != NULL) {
+      if (!spte->writable)
+        return false;
+      continue;
+    }
+    // A stack page not touched yet grows here, as it would on the
+    // process's own first write: a fault in the kernel cannot grow it.
+    if (is_user_vaddr(page) && page + PGSIZE > (uint8_t *) cur->user_esp - 32
+        && pagedir_get_page(cur->pagedir, page) == NULL) {
+      vm_grow_stack((uint32_t *) page, true);
+      continue;
+    }
+#endif
+    if (!isValidAddr((uint32_t *) page) || !pagedir_is_writable(cur->pagedir, page))
+      return false;
+  }
+  return true;
+}
+
 struct file *getFileFromFD(int fd, struct thread *t) {
   //assume lock as been acquired
   struct list_elem *iter;
@@ -3,6 +3,11 @@
 
 //sigh
 #include "threads/thread.h"
+#include "threads/synch.h"
+
+// Serializes file system calls, and anything else that changes a file's
+// inode or data.
+extern struct lock fileSystemLock;
 
 #ifdef VM
 typedef int mapid_t;
@@ -27,6 +32,7 @@ struct file *getFileFromFD(int, struct thread *);
 struct fileDescriptor *getFD(int, struct thread *);
 struct fileDescriptor *closeHelperThread(int, struct list *, struct thread *);
 struct fileDescriptor *closeHelperGlobal(int, struct list *, struct thread *);
+bool syscall_fork(struct thread *parent, struct thread *child);
 
 void setReturnStatus(tid_t, int);
 int getReturnStatus(tid_t);
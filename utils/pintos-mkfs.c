@@ -0,0 +1,317 @@
+/* pintos-mkfs.c
+
+   Writes a formatted Pintos file system partition image on the
+   host, with the named files already in its root directory, so
+   that a test run does not have to format the disk and extract
+   a ustar archive through emulated PIO at boot.
+
+   The on-disk structures below must be kept in sync with
+   filesys/inode.h, filesys/directory.c and filesys/free-map.c. */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SECTOR_SIZE 512                 /* BLOCK_SECTOR_SIZE. */
+#define FREE_MAP_SECTOR 0               /* Free map file inode sector. */
+#define ROOT_DIR_SECTOR 1               /* Root directory inode sector. */
+#define INODE_MAGIC 0x494e4f44          /* Identifies an inode. */
+#define NAME_MAX 14                     /* Longest file name. */
+#define DIRECT_CNT 10                   /* Direct pointers per inode. */
+#define PTRS_PER_SECTOR (SECTOR_SIZE / sizeof (uint32_t))
+#define MAX_SECTORS (DIRECT_CNT + PTRS_PER_SECTOR \
+                     + PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+#define ROOT_DIR_MIN_ENTRIES 16         /* As created by do_format(). */
+
+/* On-disk inode, as in filesys/inode.h. */
+struct inode_disk
+  {
+    uint32_t length;
+    uint32_t direct_block_sectors[DIRECT_CNT];
+    uint32_t indirect_block_sector;
+    uint32_t double_indirect_block;
+    uint32_t magic;
+    uint32_t sector;
+    uint32_t blocks_allocated;
+    uint32_t is_dir;
+    uint32_t flags;
+    uint32_t cluster_map;
+    uint32_t block_size;                /* 0: SECTOR_SIZE blocks. */
+    uint32_t unused[108];
+  };
+
+/* Directory entry, as in filesys/directory.c. */
+struct dir_entry
+  {
+    uint32_t inode_sector;
+    char name[NAME_MAX + 1];
+    bool in_use;
+  };
+
+/* A file to put into the image. */
+struct input
+  {
+    const char *host_name;              /* File to read on the host. */
+    const char *name;                   /* Name inside Pintos. */
+    uint8_t *data;                      /* File contents. */
+    uint32_t size;                      /* Size in bytes. */
+  };
+
+static uint8_t *image;                  /* Image contents. */
+static uint32_t sector_cnt;             /* Image size in sectors. */
+static uint32_t next_free;              /* Next sector to allocate. */
+
+static void fail (const char *msg, ...)
+     __attribute__ ((noreturn))
+     __attribute__ ((format (printf, 1, 2)));
+static void usage (int exit_code) __attribute__ ((noreturn));
+
+/* Prints MSG, formatting as with printf(), plus an error message
+   based on errno if it is set, and exits. */
+static void
+fail (const char *msg, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "pintos-mkfs: ");
+  va_start (args, msg);
+  vfprintf (stderr, msg, args);
+  va_end (args);
+
+  if (errno != 0)
+    fprintf (stderr, ": %s", strerror (errno));
+  putc ('\n', stderr);
+  exit (EXIT_FAILURE);
+}
+
+/* Returns a pointer to SECTOR within the image. */
+static void *
+sector_ptr (uint32_t sector)
+{
+  return image + (size_t) sector * SECTOR_SIZE;
+}
+
+/* Allocates CNT consecutive sectors and returns the first.
+   Sectors are handed out in order, so every file's data ends up
+   contiguous. */
+static uint32_t
+allocate (uint32_t cnt)
+{
+  uint32_t start = next_free;
+  if (cnt > sector_cnt - next_free)
+    {
+      errno = 0;
+      fail ("file system image is full (%"PRIu32" sectors)", sector_cnt);
+    }
+  next_free += cnt;
+  return start;
+}
+
+/* Creates an inode in SECTOR for SIZE bytes of data, laid out the
+   way inode_create() does, and copies DATA (which may be null for
+   a zero-filled file) into its data sectors.  Returns the first
+   data sector. */
+static uint32_t
+make_inode (uint32_t sector, const void *data, uint32_t size, bool is_dir)
+{
+  struct inode_disk *disk_inode = sector_ptr (sector);
+  uint32_t sectors = (size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  uint32_t start, i;
+
+  if (sectors > MAX_SECTORS)
+    {
+      errno = 0;
+      fail ("%"PRIu32"-byte file is too large for an inode", size);
+    }
+
+  start = allocate (sectors);
+  disk_inode->length = size;
+  disk_inode->magic = INODE_MAGIC;
+  disk_inode->sector = sector;
+  disk_inode->blocks_allocated = sectors;
+  disk_inode->is_dir = is_dir;
+  disk_inode->indirect_block_sector = allocate (1);
+  disk_inode->double_indirect_block = allocate (1);
+
+  for (i = 0; i < sectors; i++)
+    {
+      uint32_t idx = i;
+
+      if (idx < DIRECT_CNT)
+        {
+          disk_inode->direct_block_sectors[idx] = start + i;
+          continue;
+        }
+      idx -= DIRECT_CNT;
+
+      if (idx < PTRS_PER_SECTOR)
+        {
+          uint32_t *indirect = sector_ptr (disk_inode->indirect_block_sector);
+          indirect[idx] = start + i;
+          continue;
+        }
+      idx -= PTRS_PER_SECTOR;
+
+      {
+        uint32_t *dbl = sector_ptr (disk_inode->double_indirect_block);
+        uint32_t *block;
+
+        if (idx % PTRS_PER_SECTOR == 0)
+          dbl[idx / PTRS_PER_SECTOR] = allocate (1);
+        block = sector_ptr (dbl[idx / PTRS_PER_SECTOR]);
+        block[idx % PTRS_PER_SECTOR] = start + i;
+      }
+    }
+
+  if (data != NULL)
+    memcpy (sector_ptr (start), data, size);
+  return start;
+}
+
+/* Reads the host file named by IN into memory. */
+static void
+read_input (struct input *in)
+{
+  struct stat st;
+  FILE *file = fopen (in->host_name, "rb");
+
+  if (file == NULL || fstat (fileno (file), &st) < 0)
+    fail ("%s", in->host_name);
+  in->size = st.st_size;
+  in->data = malloc (in->size + 1);
+  if (in->data == NULL)
+    fail ("%s: out of memory", in->host_name);
+  if (fread (in->data, 1, in->size, file) != in->size)
+    fail ("%s: read failed", in->host_name);
+  fclose (file);
+}
+
+static void
+usage (int exit_code)
+{
+  printf ("pintos-mkfs, writes a formatted Pintos file system image\n"
+          "usage: pintos-mkfs [-s SIZE] IMAGE [FILE[:NAME]...]\n"
+          "where IMAGE is the partition image to create,\n"
+          "  each FILE is copied into its root directory, as NAME\n"
+          "    if given or under its base name otherwise,\n"
+          "  and SIZE is the image size in MB (default: 2).\n"
+          "Use the image with \"pintos --filesys=IMAGE\" and without -f.\n");
+  exit (exit_code);
+}
+
+int
+main (int argc, char *argv[])
+{
+  double size_mb = 2.0;
+  const char *image_name;
+  struct input *inputs;
+  int input_cnt;
+  uint32_t bitmap_bytes, entry_cnt, free_map_start, root_start;
+  struct dir_entry *entries;
+  uint32_t i;
+  int opt;
+  FILE *out;
+
+  while ((opt = getopt (argc, argv, "hs:")) != -1)
+    switch (opt)
+      {
+      case 's':
+        size_mb = strtod (optarg, NULL);
+        if (size_mb <= 0)
+          usage (EXIT_FAILURE);
+        break;
+      case 'h':
+        usage (EXIT_SUCCESS);
+      default:
+        usage (EXIT_FAILURE);
+      }
+  if (optind >= argc)
+    usage (EXIT_FAILURE);
+  image_name = argv[optind++];
+
+  /* Read the input files. */
+  input_cnt = argc - optind;
+  inputs = calloc (input_cnt + 1, sizeof *inputs);
+  for (i = 0; i < (uint32_t) input_cnt; i++)
+    {
+      struct input *in = &inputs[i];
+      char *arg = argv[optind + i];
+      char *colon = strrchr (arg, ':');
+      uint32_t j;
+
+      if (colon != NULL)
+        {
+          *colon = '\0';
+          in->name = colon + 1;
+        }
+      else
+        {
+          const char *slash = strrchr (arg, '/');
+          in->name = slash != NULL ? slash + 1 : arg;
+        }
+      in->host_name = arg;
+
+      errno = 0;
+      if (*in->name == '\0' || strlen (in->name) > NAME_MAX)
+        fail ("\"%s\": file name must be 1 to %d characters",
+              in->name, NAME_MAX);
+      for (j = 0; j < i; j++)
+        if (!strcmp (inputs[j].name, in->name))
+          fail ("\"%s\": duplicate file name", in->name);
+      read_input (in);
+    }
+
+  /* Allocate the image.  Sizes round up to a whole sector the
+     same way "pintos --filesys-size" does. */
+  sector_cnt = ((uint64_t) (size_mb * 1024 * 1024) + SECTOR_SIZE - 1)
+               / SECTOR_SIZE;
+  image = calloc (sector_cnt, SECTOR_SIZE);
+  if (image == NULL)
+    fail ("out of memory");
+  next_free = ROOT_DIR_SECTOR + 1;
+
+  /* Free map and root directory, in the same order as
+     do_format(). */
+  bitmap_bytes = (sector_cnt + 31) / 32 * 4;
+  free_map_start = make_inode (FREE_MAP_SECTOR, NULL, bitmap_bytes, false);
+  entry_cnt = input_cnt > ROOT_DIR_MIN_ENTRIES
+              ? (uint32_t) input_cnt : ROOT_DIR_MIN_ENTRIES;
+  root_start = make_inode (ROOT_DIR_SECTOR, NULL,
+                           entry_cnt * sizeof (struct dir_entry), true);
+
+  /* Files. */
+  entries = sector_ptr (root_start);
+  for (i = 0; i < (uint32_t) input_cnt; i++)
+    {
+      struct input *in = &inputs[i];
+      uint32_t inode_sector = allocate (1);
+
+      make_inode (inode_sector, in->data, in->size, false);
+      entries[i].inode_sector = inode_sector;
+      strncpy (entries[i].name, in->name, NAME_MAX);
+      entries[i].in_use = true;
+    }
+
+  /* Everything below NEXT_FREE is in use.  The kernel's bitmap
+     stores bit N of the map in bit N % 8 of byte N / 8. */
+  {
+    uint8_t *bitmap = sector_ptr (free_map_start);
+    for (i = 0; i < next_free; i++)
+      bitmap[i / 8] |= 1 << (i % 8);
+  }
+
+  out = fopen (image_name, "wb");
+  if (out == NULL)
+    fail ("%s: create", image_name);
+  if (fwrite (image, SECTOR_SIZE, sector_cnt, out) != sector_cnt
+      || fclose (out) != 0)
+    fail ("%s: write", image_name);
+  return EXIT_SUCCESS;
+}
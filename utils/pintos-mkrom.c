@@ -0,0 +1,281 @@
+/* pintos-mkrom.c
+
+   Writes a read-only, compressed Pintos boot image on the host,
+   holding the named files, for the kernel to mount from the
+   scratch disk and execute from directly, so that a test run
+   does not have to extract its programs into the file system
+   first.
+
+   The image format is described in filesys/romfs.h, and the
+   structures below must be kept in sync with filesys/romfs.c. */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <lz.h>
+
+#define SECTOR_SIZE 512                 /* BLOCK_SECTOR_SIZE. */
+#define NAME_MAX 14                     /* Longest file name. */
+#define ROMFS_MAGIC 0x4d4f5250          /* Identifies an image. */
+#define ROMFS_CLUSTER_SIZE 4096         /* Uncompressed cluster size. */
+
+/* Image header, as in filesys/romfs.c. */
+struct romfs_super
+  {
+    uint32_t magic;
+    uint32_t file_cnt;
+    uint32_t cluster_cnt;
+    uint32_t dir_ofs;
+    uint32_t cluster_ofs;
+    uint32_t size;
+  };
+
+/* Directory entry, as in filesys/romfs.c. */
+struct romfs_entry
+  {
+    char name[NAME_MAX + 1];
+    uint8_t unused;
+    uint32_t size;
+    uint32_t first_cluster;
+  };
+
+/* Cluster table entry, as in filesys/romfs.c. */
+struct romfs_cluster
+  {
+    uint32_t ofs;
+    uint32_t size;
+  };
+
+/* A file to put into the image. */
+struct input
+  {
+    const char *host_name;              /* File to read on the host. */
+    const char *name;                   /* Name inside Pintos. */
+    uint8_t *data;                      /* File contents. */
+    uint32_t size;                      /* Size in bytes. */
+  };
+
+static void fail (const char *msg, ...)
+     __attribute__ ((noreturn))
+     __attribute__ ((format (printf, 1, 2)));
+static void usage (int exit_code) __attribute__ ((noreturn));
+
+/* Prints MSG, formatting as with printf(), plus an error message
+   based on errno if it is set, and exits. */
+static void
+fail (const char *msg, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "pintos-mkrom: ");
+  va_start (args, msg);
+  vfprintf (stderr, msg, args);
+  va_end (args);
+
+  if (errno != 0)
+    fprintf (stderr, ": %s", strerror (errno));
+  putc ('\n', stderr);
+  exit (EXIT_FAILURE);
+}
+
+/* lib/lz.c reports failed assertions through this. */
+void
+debug_panic (const char *file, int line, const char *function,
+             const char *message, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "pintos-mkrom: %s:%d in %s(): ", file, line, function);
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+  putc ('\n', stderr);
+  abort ();
+}
+
+/* Reads the host file named by IN into memory. */
+static void
+read_input (struct input *in)
+{
+  struct stat st;
+  FILE *file = fopen (in->host_name, "rb");
+
+  if (file == NULL || fstat (fileno (file), &st) < 0)
+    fail ("%s", in->host_name);
+  in->size = st.st_size;
+  in->data = malloc (in->size + 1);
+  if (in->data == NULL)
+    fail ("%s: out of memory", in->host_name);
+  if (fread (in->data, 1, in->size, file) != in->size)
+    fail ("%s: read failed", in->host_name);
+  fclose (file);
+}
+
+/* Orders inputs by name, the order the kernel searches in. */
+static int
+compare_inputs (const void *a_, const void *b_)
+{
+  const struct input *a = a_;
+  const struct input *b = b_;
+
+  return strcmp (a->name, b->name);
+}
+
+static void
+usage (int exit_code)
+{
+  printf ("pintos-mkrom, writes a compressed read-only Pintos boot image\n"
+          "usage: pintos-mkrom IMAGE FILE[:NAME]...\n"
+          "where IMAGE is the image to create and\n"
+          "  each FILE is copied into it, as NAME\n"
+          "    if given or under its base name otherwise.\n"
+          "Use the image with \"pintos --scratch=IMAGE\"; the kernel\n"
+          "mounts it at /rom and runs programs from it by name.\n");
+  exit (exit_code);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *image_name;
+  struct input *inputs;
+  uint32_t input_cnt, cluster_cnt, data_ofs, ofs, i;
+  struct romfs_super super;
+  struct romfs_entry *entries;
+  struct romfs_cluster *clusters;
+  uint8_t *data;
+  size_t data_cap;
+  void *work;
+  FILE *out;
+
+  if (argc == 2 && !strcmp (argv[1], "-h"))
+    usage (EXIT_SUCCESS);
+  if (argc < 3)
+    usage (EXIT_FAILURE);
+  image_name = argv[1];
+
+  /* Read the input files. */
+  input_cnt = argc - 2;
+  inputs = calloc (input_cnt, sizeof *inputs);
+  if (inputs == NULL)
+    fail ("out of memory");
+  cluster_cnt = 0;
+  for (i = 0; i < input_cnt; i++)
+    {
+      struct input *in = &inputs[i];
+      char *arg = argv[2 + i];
+      char *colon = strrchr (arg, ':');
+
+      if (colon != NULL)
+        {
+          *colon = '\0';
+          in->name = colon + 1;
+        }
+      else
+        {
+          const char *slash = strrchr (arg, '/');
+          in->name = slash != NULL ? slash + 1 : arg;
+        }
+      in->host_name = arg;
+
+      errno = 0;
+      if (*in->name == '\0' || strlen (in->name) > NAME_MAX
+          || strchr (in->name, '/') != NULL)
+        fail ("\"%s\": file name must be 1 to %d characters, "
+              "without slashes", in->name, NAME_MAX);
+      read_input (in);
+      cluster_cnt += (in->size + ROMFS_CLUSTER_SIZE - 1) / ROMFS_CLUSTER_SIZE;
+    }
+
+  /* The kernel binary searches the directory. */
+  qsort (inputs, input_cnt, sizeof *inputs, compare_inputs);
+  for (i = 1; i < input_cnt; i++)
+    if (!strcmp (inputs[i - 1].name, inputs[i].name))
+      {
+        errno = 0;
+        fail ("\"%s\": duplicate file name", inputs[i].name);
+      }
+
+  /* Lay out the header, directory, and cluster table. */
+  memset (&super, 0, sizeof super);
+  super.magic = ROMFS_MAGIC;
+  super.file_cnt = input_cnt;
+  super.cluster_cnt = cluster_cnt;
+  super.dir_ofs = SECTOR_SIZE;
+  super.cluster_ofs = super.dir_ofs + input_cnt * sizeof *entries;
+  data_ofs = super.cluster_ofs + cluster_cnt * sizeof *clusters;
+
+  entries = calloc (input_cnt, sizeof *entries);
+  clusters = calloc (cluster_cnt + 1, sizeof *clusters);
+  data_cap = 0;
+  for (i = 0; i < input_cnt; i++)
+    data_cap += inputs[i].size;
+  data = malloc (data_cap + 1);
+  work = malloc (LZ_WORK_SIZE);
+  if (entries == NULL || clusters == NULL || data == NULL || work == NULL)
+    fail ("out of memory");
+
+  /* Compress each file a cluster at a time, keeping a cluster
+     uncompressed unless compression makes it smaller. */
+  ofs = 0;
+  cluster_cnt = 0;
+  for (i = 0; i < input_cnt; i++)
+    {
+      struct input *in = &inputs[i];
+      struct romfs_entry *e = &entries[i];
+      uint32_t pos;
+
+      strncpy (e->name, in->name, NAME_MAX);
+      e->size = in->size;
+      e->first_cluster = cluster_cnt;
+      for (pos = 0; pos < in->size; pos += ROMFS_CLUSTER_SIZE)
+        {
+          struct romfs_cluster *c = &clusters[cluster_cnt++];
+          uint32_t length = in->size - pos;
+          size_t size = 0;
+
+          if (length > ROMFS_CLUSTER_SIZE)
+            length = ROMFS_CLUSTER_SIZE;
+          if (length > 1)
+            size = lz_compress (in->data + pos, length,
+                                data + ofs, length - 1, work);
+          if (size == 0)
+            {
+              memcpy (data + ofs, in->data + pos, length);
+              size = length;
+            }
+          c->ofs = data_ofs + ofs;
+          c->size = size;
+          ofs += size;
+        }
+    }
+  super.size = data_ofs + ofs;
+
+  /* Write the image, padded to a whole number of sectors. */
+  out = fopen (image_name, "wb");
+  if (out == NULL)
+    fail ("%s: create", image_name);
+  {
+    static const uint8_t zeros[SECTOR_SIZE];
+    uint32_t pad = (SECTOR_SIZE - super.size % SECTOR_SIZE) % SECTOR_SIZE;
+
+    if (fwrite (&super, sizeof super, 1, out) != 1
+        || fwrite (zeros, SECTOR_SIZE - sizeof super, 1, out) != 1
+        || fwrite (entries, sizeof *entries, input_cnt, out) != input_cnt
+        || fwrite (clusters, sizeof *clusters, cluster_cnt, out) != cluster_cnt
+        || fwrite (data, 1, ofs, out) != ofs
+        || fwrite (zeros, 1, pad, out) != pad
+        || fclose (out) != 0)
+      fail ("%s: write", image_name);
+  }
+
+  printf ("%s: %"PRIu32" files, %"PRIu32" bytes compressed to %"PRIu32"\n",
+          image_name, input_cnt, (uint32_t) data_cap, ofs);
+  return EXIT_SUCCESS;
+}
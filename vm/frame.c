@@ -1,3 +1,4 @@
+#include <bitmap.h>
 #include <list.h>
 #include <stdio.h>
 #include <string.h>
@@ -8,24 +9,111 @@
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/vaddr.h"
 #include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
+#include "filesys/cache.h"
 
 //CC vs _ inconsistent
 
 
-static struct list frame_table;
+// Frame table: one entry per frame of the user pool, indexed by
+// (kpage - user_base) / PGSIZE, so finding a frame's entry takes no
+// search and claiming one takes no allocation. An entry is in use while
+// its frame is non-null.
+static struct frame_table_entry *frame_table;
+static size_t frame_cnt;
+static uint8_t *user_base;
+
+// Page cache pages mapped into processes. They come from the kernel
+// pool and may be mapped by several processes at once, so their entries
+// are allocated separately. Evicting one frees no frame, so the clock
+// never looks at them; instead at most CACHE_MAP_MAX of them exist at
+// once, counting those being set up, and a process over the limit gives
+// back its oldest mapping first (see map_cache_page()).
+static struct list cache_mappings;
+static size_t cache_map_cnt;
+
+// Half of the page cache, so that mapped pages, which the cache cannot
+// evict, always leave it room for read() and write().
+#define CACHE_MAP_MAX 32
+
+// Read-only executable pages currently in a frame, keyed by where they
+// came from, so that a process faulting one in maps the frame another
+// process already loaded instead of reading its own copy.
+static struct hash shared_frames;
+
+// Mapped read-only at every zero-fill page that has only been read, until
+// the first write gives the page a frame of its own. It comes from the
+// kernel pool, so the clock never sees it, and is never freed.
+static uint8_t *zero_frame;
+
 static struct lock frame_table_lock;
 static struct lock get_frame;
 
+// Broadcast, under frame_table_lock, whenever a pinned frame table entry
+// is unpinned or released, for threads waiting out a load or eviction.
+static struct condition frame_unpinned;
+
+// The page cleaner keeps between free_low and free_high user frames
+// free, so that faults seldom have to evict.
+static size_t free_low, free_high;
+static struct lock cleaner_lock;
+static struct condition cleaner_cond;
+static thread_func page_cleaner NO_RETURN;
+
+// Most pages a fault on a file-backed page brings in, counting its own.
+// The neighbours come from the aligned window of this many pages that
+// holds the faulting page.
+#define FAULT_AROUND_PAGES 16
+
+// Clock hand: index of the frame table entry the eviction sweep looks
+// at next.
+static size_t clock_hand;
+
 static bool install_page (void *upage, void *kpage, bool writable);
+static void frame_table_add(struct frame_table_entry *);
+static void frame_table_remove(struct frame_table_entry *);
+static void frame_unpin(struct frame_table_entry *);
+static void frame_table_free(struct frame_table_entry *);
+static bool frame_needs_write(struct frame_table_entry *);
+static struct frame_table_entry *clock_select(void);
+static void wait_for_unpinned_frame(void);
+static bool fs_lock_acquire(void);
+static bool evict_frame(struct frame_table_entry *);
+static hash_hash_func shared_hash;
+static hash_less_func shared_less;
+static bool share_text_page(void *upage, struct sPageTableEntry *spte, bool may_evict);
+static size_t fault_around_window(struct sPageTableEntry *, struct sPageTableEntry **);
+static bool map_around(struct sPageTableEntry *);
+static uint32_t *map_cache_page(struct sPageTableEntry *, bool may_evict);
+static void evict_cache_mapping(struct frame_table_entry *);
 
 void frame_init(void) {
-  list_init(&frame_table);
+  user_base = palloc_user_pool(&frame_cnt);
+  frame_table = calloc(frame_cnt, sizeof *frame_table);
+  if (frame_table == NULL)
+    PANIC("frame table allocation failed");
+  list_init(&cache_mappings);
+  cache_map_cnt = 0;
+  hash_init(&shared_frames, shared_hash, shared_less, NULL);
+  zero_frame = palloc_get_page(PAL_ZERO | PAL_ASSERT);
   lock_init(&frame_table_lock);
   lock_init(&get_frame);
+  cond_init(&frame_unpinned);
+  clock_hand = 0;
+
+  free_low = frame_cnt / 32 + 2;
+  free_high = 2 * free_low;
+  lock_init(&cleaner_lock);
+  cond_init(&cleaner_cond);
+  if (thread_create("pagecleaner", PRI_DEFAULT, page_cleaner, NULL) == TID_ERROR)
+    PANIC("couldn't start page cleaner");
 }
 
 
@@ -33,7 +121,7 @@ bool vm_free_frame(void *vpage_base) {
 
   ASSERT(pg_ofs(vpage_base) == 0);
 
-  struct frame_table_entry *fte = vm_find_in_list(vpage_base);
+  struct frame_table_entry *fte = vm_find_frame(vpage_base);
   if (fte == NULL)
     return false;
 
@@ -59,15 +147,14 @@ bool vm_free_frame(void *vpage_base) {
 // }
 
 
-struct frame_table_entry *vm_find_in_list(uint32_t *vpage_base) {
-  struct list_elem *e;
-  for (e = list_begin(&frame_table); e != list_end(&frame_table); e = list_next(e)) {
-    struct frame_table_entry *fte = list_entry(e, struct frame_table_entry, elem);
-    if (fte->frame == vpage_base)
-      return fte;
-  }
+// Returns the frame table entry for user frame KPAGE, or NULL if KPAGE
+// is not an allocated user frame.
+struct frame_table_entry *vm_find_frame(uint32_t *kpage) {
+  size_t idx = ((uint8_t *) kpage - user_base) / PGSIZE;
 
-  return NULL;
+  if ((uint8_t *) kpage < user_base || idx >= frame_cnt || frame_table[idx].frame != kpage)
+    return NULL;
+  return &frame_table[idx];
 }
 
 
@@ -80,37 +167,397 @@ static bool install_page (void *upage, void *kpage, bool writable) {
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
 
-void vm_load_install(uint32_t *fault_addr, struct sPageTableEntry *spte) {
+void vm_load_install(uint32_t *fault_addr, struct sPageTableEntry *spte, bool write) {
 
   uint32_t *fault_base = pg_round_down(fault_addr);
-  uint32_t *frame = _vm_get_frame(PAL_USER | PAL_ZERO);
-  struct frame_table_entry *fte = _vm_malloc_fte(frame, spte);
+  uint32_t *frame = NULL;
+  struct frame_table_entry *fte;
+  struct sPageTableEntry *around[FAULT_AROUND_PAGES];
+  size_t around_cnt = 0, i;
+
+  // Wait out an eviction of the page, by the page cleaner or another
+  // process: until it clears spte->fte, the page may still be on its way
+  // to swap, and its location and slot are not final.
+  lock_acquire(&frame_table_lock);
+  while (spte->fte != NULL && spte->fte->pinned)
+    cond_wait(&frame_unpinned, &frame_table_lock);
+  lock_release(&frame_table_lock);
 
-  if (spte->location & LOC_SWAP)
-    _vm_load_from_disk(fault_base, fte);
-  else if (spte->location & LOC_MMAP)
-    _vm_load_from_file(fault_base, fte);
-  else if (spte->location & LOC_ZERO)
-    memset(frame, 0, PGSIZE); //UNNECESSARY @ page is zeroed
-  else
-    PANIC("Couldn't locate contents of SPTE");
+  // A fault on a file-backed page maps its neighbours in the file too,
+  // and their data is read in one go before any of them is filled in.
+  if (spte->location & LOC_MMAP)
+    around_cnt = fault_around_window(spte, around);
+
+  if (spte->location == LOC_ZERO && !write) {
+    // Reading a page that was never written: it reads as zeros either way.
+    install_page(fault_base, zero_frame, false);
+  } else if ((spte->location & LOC_EXEC) && !spte->writable) {
+    share_text_page(fault_base, spte, true);
+  } else {
+    // mmap()'d pages map the page cache's copy directly, so every
+    // process mapping the file shares one frame. Falls back to a
+    // private copy if the cache cannot lend another page.
+    if (spte->location & LOC_SHRD)
+      frame = map_cache_page(spte, true);
+
+    if (frame != NULL) {
+      fte = _vm_claim_fte(frame, spte, true);
+    } else {
+      frame = _vm_get_frame(PAL_USER | PAL_ZERO);
+      fte = _vm_claim_fte(frame, spte, false);
+
+      if (spte->location & LOC_SWAP)
+        _vm_load_from_disk(fault_base, fte);
+      else if (spte->location & LOC_MMAP)
+        _vm_load_from_file(fault_base, fte);
+      else if (spte->location != LOC_ZERO)
+        PANIC("Couldn't locate contents of SPTE");
+    }
+
+    // A zero-fill page with a frame of its own is anonymous from now on.
+    if (spte->location == LOC_ZERO)
+      spte->location = LOC_SWAP;
+
+    fte->aux->fte = fte;
+    frame_table_add(fte);
+
+    install_page(fault_base, frame, spte->writable);
+  }
+
+  for (i = 0; i < around_cnt && map_around(around[i]); i++)
+    continue;
+}
+
+// Returns the current thread's SPTE for UPAGE if that page can be
+// brought in along with faulting page SPTE: the same kind of mapping of
+// the same file at the matching offset, and not in memory.
+static struct sPageTableEntry *around_page(struct sPageTableEntry *spte, uint8_t *upage) {
+  struct thread *t = thread_current();
+  struct sPageTableEntry *n;
+  off_t ofs = spte->file_offset + (upage - (uint8_t *) spte->user_vaddr);
+
+  if (!is_user_vaddr(upage) || upage < (uint8_t *) PGSIZE)
+    return NULL;
+  n = page_lookup(upage, &t->s_pte);
+  if (n == NULL || n->fte != NULL || n->location != spte->location
+      || n->writable != spte->writable || n->file_offset != ofs
+      || file_get_inode(n->file) != file_get_inode(spte->file)
+      || pagedir_get_page(t->pagedir, upage) != NULL)
+    return NULL;
+  return n;
+}
+
+// Stores in AROUND, in address order, the pages next to faulting page
+// SPTE that can come in with it (see around_page()), up to the edges of
+// its fault-around window, and has the page cache read the file data
+// for all of them, SPTE's included, in as few requests as it can.
+// Returns the number of pages stored.
+static size_t fault_around_window(struct sPageTableEntry *spte, struct sPageTableEntry **around) {
+  uint8_t *upage = (uint8_t *) spte->user_vaddr;
+  uint8_t *start = (uint8_t *) ((uintptr_t) upage & ~(uintptr_t) (FAULT_AROUND_PAGES * PGSIZE - 1));
+  uint8_t *end = start + FAULT_AROUND_PAGES * PGSIZE;
+  uint8_t *lo = upage, *hi = upage + PGSIZE, *p;
+  size_t cnt = 0;
+
+  while (lo > start && around_page(spte, lo - PGSIZE) != NULL)
+    lo -= PGSIZE;
+  while (hi < end && around_page(spte, hi) != NULL)
+    hi += PGSIZE;
+  for (p = lo; p < hi; p += PGSIZE)
+    if (p != upage)
+      around[cnt++] = around_page(spte, p);
+
+  if (cnt > 0)
+    cache_prefetch(file_get_inode(spte->file), spte->file_offset - (upage - lo), hi - lo);
+  return cnt;
+}
+
+// Maps page SPTE, found by fault_around_window(), if that can be done
+// without evicting anything. Returns false if it cannot.
+static bool map_around(struct sPageTableEntry *spte) {
+  void *upage = spte->user_vaddr;
+  struct frame_table_entry *fte;
+  uint32_t *frame;
+
+  if ((spte->location & LOC_EXEC) && !spte->writable)
+    return share_text_page(upage, spte, false);
+
+  if (spte->location & LOC_SHRD) {
+    frame = map_cache_page(spte, false);
+    if (frame == NULL)
+      return false;
+    fte = _vm_claim_fte(frame, spte, true);
+  } else {
+    frame = palloc_get_page(PAL_USER | PAL_ZERO);
+    if (frame == NULL)
+      return false;
+    fte = _vm_claim_fte(frame, spte, false);
+    _vm_load_from_file(upage, fte);
+  }
+
+  spte->fte = fte;
+  frame_table_add(fte);
+  install_page(upage, frame, spte->writable);
+  return true;
+}
+
+// Returns the page cache's copy of SPTE's page, pinned for mapping into
+// the current thread, or NULL if the caller should make a private copy.
+// Once CACHE_MAP_MAX cache pages are mapped, the current thread's oldest
+// mapping is given back to make room if MAY_EVICT; otherwise, or if the
+// thread has none, returns NULL.
+static uint32_t *map_cache_page(struct sPageTableEntry *spte, bool may_evict) {
+  struct thread *t = thread_current();
+  struct frame_table_entry *victim;
+  struct list_elem *e;
+  uint32_t *frame;
 
-  fte->aux->fte = fte;
   lock_acquire(&frame_table_lock);
-  list_push_back(&frame_table, &fte->elem);
+  while (cache_map_cnt >= CACHE_MAP_MAX) {
+    victim = NULL;
+    for (e = list_begin(&cache_mappings); may_evict && e != list_end(&cache_mappings); e = list_next(e)) {
+      struct frame_table_entry *fte = list_entry(e, struct frame_table_entry, elem);
+      if (fte->owner == t) {
+        victim = fte;
+        break;
+      }
+    }
+    if (victim == NULL) {
+      lock_release(&frame_table_lock);
+      return NULL;
+    }
+    frame_table_remove(victim);
+    lock_release(&frame_table_lock);
+    evict_cache_mapping(victim);
+    lock_acquire(&frame_table_lock);
+  }
+  cache_map_cnt++;
   lock_release(&frame_table_lock);
 
-  install_page(fault_base, frame, true);
+  frame = cache_map(file_get_inode(spte->file), spte->file_offset, spte->writable);
+  if (frame == NULL) {
+    lock_acquire(&frame_table_lock);
+    cache_map_cnt--;
+    lock_release(&frame_table_lock);
+  }
+  return frame;
+}
+
+// Unmaps page cache mapping FTE, taken out of the frame table with
+// frame_table_remove(), and hands the page back to the cache, which
+// writes it back if it was modified.
+static void evict_cache_mapping(struct frame_table_entry *fte) {
+  struct sPageTableEntry *spte = fte->aux;
+  bool dirty = spte->dirty || pagedir_is_dirty(fte->owner->pagedir, spte->user_vaddr);
 
+  pagedir_clear_page(fte->owner->pagedir, spte->user_vaddr);
+  spte->fte = NULL;
+  cache_unmap(file_get_inode(spte->file), spte->file_offset, spte->writable, dirty);
+  frame_table_free(fte);
 }
 
-void _vm_load_from_disk(uint32_t *fault_base UNUSED, struct frame_table_entry *fte) {
+static unsigned shared_hash(const struct hash_elem *e, void *aux UNUSED) {
+  const struct frame_table_entry *fte = hash_entry(e, struct frame_table_entry, hash_elem);
+  return hash_bytes(&fte->inode, sizeof fte->inode) ^ hash_int(fte->offset) ^ hash_int(fte->read_bytes);
+}
+
+static bool shared_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+  const struct frame_table_entry *a = hash_entry(a_, struct frame_table_entry, hash_elem);
+  const struct frame_table_entry *b = hash_entry(b_, struct frame_table_entry, hash_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->offset != b->offset)
+    return a->offset < b->offset;
+  return a->read_bytes < b->read_bytes;
+}
+
+// Returns the shared frame holding SPTE's page, or NULL if none does.
+// Caller must hold frame_table_lock.
+static struct frame_table_entry *shared_lookup(struct sPageTableEntry *spte) {
+  struct frame_table_entry key;
+  struct hash_elem *e;
+
+  key.inode = file_get_inode(spte->file);
+  key.offset = spte->file_offset;
+  key.read_bytes = spte->read_bytes;
+  e = hash_find(&shared_frames, &key.hash_elem);
+  return e != NULL ? hash_entry(e, struct frame_table_entry, hash_elem) : NULL;
+}
+
+// Adds SPTE to the mappings of shared frame FTE. Caller must hold
+// frame_table_lock.
+static void shared_attach(struct frame_table_entry *fte, struct sPageTableEntry *spte) {
+  list_push_back(&fte->sharers, &spte->rmap_elem);
+  fte->share_cnt++;
+  spte->fte = fte;
+}
+
+// Maps read-only executable page SPTE at UPAGE. Every process running
+// the same executable maps the same frame, which is read from the file
+// by whichever process faults on the page first. Unless MAY_EVICT, gives
+// up and returns false rather than wait for a page being read in or
+// evict one to make room; otherwise returns true.
+static bool share_text_page(void *upage, struct sPageTableEntry *spte, bool may_evict) {
+  struct frame_table_entry *fte;
+  uint32_t *frame;
+  size_t idx;
+
+ retry:
+  lock_acquire(&frame_table_lock);
+  fte = shared_lookup(spte);
+  if (fte != NULL && !fte->pinned) {
+    shared_attach(fte, spte);
+    frame = fte->frame;
+    lock_release(&frame_table_lock);
+    install_page(upage, frame, false);
+    return true;
+  }
+  if (fte != NULL) {
+    // Being read in or evicted by someone else.
+    if (may_evict)
+      cond_wait(&frame_unpinned, &frame_table_lock);
+    lock_release(&frame_table_lock);
+    if (!may_evict)
+      return false;
+    goto retry;
+  }
+  lock_release(&frame_table_lock);
+
+  frame = may_evict ? _vm_get_frame(PAL_USER | PAL_ZERO) : palloc_get_page(PAL_USER | PAL_ZERO);
+  if (frame == NULL)
+    return false;
+  lock_acquire(&frame_table_lock);
+  if (shared_lookup(spte) != NULL) {
+    // Another process got there while we were finding a frame.
+    lock_release(&frame_table_lock);
+    palloc_free_page(frame);
+    goto retry;
+  }
+  idx = ((uint8_t *) frame - user_base) / PGSIZE;
+  fte = &frame_table[idx];
+  ASSERT(fte->frame == NULL);
+  fte->frame = frame;
+  fte->owner = NULL;
+  fte->aux = NULL;
+  fte->cached = false;
+  fte->pinned = true;
+  fte->shared = true;
+  list_init(&fte->sharers);
+  fte->share_cnt = 0;
+  fte->inode = file_get_inode(spte->file);
+  fte->offset = spte->file_offset;
+  fte->read_bytes = spte->read_bytes;
+  hash_insert(&shared_frames, &fte->hash_elem);
+  lock_release(&frame_table_lock);
+
+  file_read_at(spte->file, frame, spte->read_bytes, spte->file_offset);
+
+  lock_acquire(&frame_table_lock);
+  shared_attach(fte, spte);
+  frame_unpin(fte);
+  lock_release(&frame_table_lock);
+  install_page(upage, frame, false);
+  return true;
+}
+
+// Drops SPTE's mapping of a shared frame, and frees the frame if that
+// was the last one. Does nothing if SPTE's page is not in a shared frame,
+// for instance because it was just evicted.
+static void shared_detach(struct sPageTableEntry *spte) {
+  struct frame_table_entry *fte;
+  uint32_t *frame = NULL;
+
+  lock_acquire(&frame_table_lock);
+  fte = spte->fte;
+  if (fte == NULL || !fte->shared) {
+    lock_release(&frame_table_lock);
+    return;
+  }
+  pagedir_clear_page(spte->owner->pagedir, spte->user_vaddr);
+  list_remove(&spte->rmap_elem);
+  spte->fte = NULL;
+  if (--fte->share_cnt == 0 && !fte->pinned) {
+    if (fte->inode != NULL)
+      hash_delete(&shared_frames, &fte->hash_elem);
+    frame = fte->frame;
+    fte->frame = NULL;
+  }
+  lock_release(&frame_table_lock);
+
+  if (frame != NULL)
+    palloc_free_page(frame);
+}
+
+// Returns the current thread's SPTE for UPAGE if that page is swapped
+// out to SLOT and not mapped, otherwise NULL.
+static struct sPageTableEntry *swapped_page(uint8_t *upage, size_t slot) {
+  struct thread *t = thread_current();
+  struct sPageTableEntry *spte;
+
+  if (!is_user_vaddr(upage) || upage < (uint8_t *) PGSIZE)
+    return NULL;
+  spte = page_lookup(upage, &t->s_pte);
+  if (spte == NULL || !(spte->location & LOC_SWAP) || spte->fte != NULL
+      || spte->disk_offset != slot || pagedir_get_page(t->pagedir, upage) != NULL)
+    return NULL;
+  return spte;
+}
+
+// Reads FTE's page back from swap. Neighbouring pages of the same
+// process that went out to the neighbouring slots (see
+// _vm_write_back_to_disk()) come in with it, in the same request, and
+// are mapped speculatively, as long as free frames are at hand without
+// evicting anything.
+void _vm_load_from_disk(uint32_t *fault_base, struct frame_table_entry *fte) {
 
   ASSERT (fte != NULL && fte->aux != NULL);
 
   struct sPageTableEntry *spte = fte->aux;
-  read_from_block(fte->frame, spte->disk_offset);
+  struct sPageTableEntry *run[SWAP_CLUSTER_MAX];
+  uint32_t *frames[SWAP_CLUSTER_MAX];
+  uint8_t *upage = (uint8_t *) fault_base;
+  size_t slot = spte->disk_offset;
+  size_t before = 0, after = 0, cnt, i;
+
+  // Extend the run forward, then backward, while pages and slots line up.
+  while (1 + before + after < SWAP_CLUSTER_MAX
+         && swapped_page(upage + (after + 1) * PGSIZE, slot + after + 1) != NULL)
+    after++;
+  while (1 + before + after < SWAP_CLUSTER_MAX && slot > before
+         && swapped_page(upage - (before + 1) * PGSIZE, slot - before - 1) != NULL)
+    before++;
+  cnt = 1 + before + after;
+
+  for (i = 0; i < cnt; i++) {
+    if (i == before) {
+      run[i] = spte;
+      frames[i] = fte->frame;
+      continue;
+    }
+    run[i] = swapped_page(upage - before * PGSIZE + i * PGSIZE, slot - before + i);
+    frames[i] = palloc_get_page(PAL_USER);
+    if (frames[i] == NULL)
+      break;
+  }
+  if (i < cnt) {
+    // Short of free frames: read just the one page.
+    while (i-- > 0)
+      if (i != before)
+        palloc_free_page(frames[i]);
+    read_from_block(fte->frame, slot);
+    return;
+  }
 
+  read_run_from_block(frames, slot - before, cnt);
+  for (i = 0; i < cnt; i++) {
+    if (i == before)
+      continue;
+    struct frame_table_entry *ra = _vm_claim_fte(frames[i], run[i], false);
+    run[i]->fte = ra;
+    frame_table_add(ra);
+    install_page(run[i]->user_vaddr, frames[i], run[i]->writable);
+  }
 }
 
 void _vm_load_from_file(uint32_t *fault_base UNUSED, struct frame_table_entry *fte) {
@@ -122,9 +569,8 @@ void _vm_load_from_file(uint32_t *fault_base UNUSED, struct frame_table_entry *f
   ASSERT (spte->file != NULL /*&& spte->file_offset != -1*/);
 
 
-  struct file *file = file_reopen(spte->file);
-
-  off_t bytes_transferred = file_read_at(file, fte->frame, spte->read_bytes, spte->file_offset);
+  // Copied out of the page cache, so only the first fault reads the disk
+  off_t bytes_transferred = file_read_at(spte->file, fte->frame, spte->read_bytes, spte->file_offset);
   //EOF -> vm_load_install uses flag PAL_ZERO (just in case)
 
   // if (spte->file == NULL) {
@@ -160,22 +606,82 @@ struct mmap_file *_vm_malloc_mmap(void *vaddr_base, int fd, int pages_taken, str
 }
 
 
+// Returns a free frame, normally straight from the reserve that the page
+// cleaner keeps. If the reserve has run dry, evicts a frame itself.
 uint32_t *_vm_get_frame(enum palloc_flags flags) {
-  lock_acquire(&get_frame);
   uint32_t *kpage = palloc_get_page(flags);
 
-  if (kpage == NULL) {
+  if (palloc_user_free_cnt() < free_low) {
+    lock_acquire(&cleaner_lock);
+    cond_signal(&cleaner_cond, &cleaner_lock);
+    lock_release(&cleaner_lock);
+  }
+  if (kpage != NULL)
+    return kpage;
+
+  // Eviction may write to a file, so it needs fileSystemLock, taken
+  // before get_frame like everyone else takes it.
+  bool fs_locked = fs_lock_acquire();
+  lock_acquire(&get_frame);
+  kpage = palloc_get_page(flags);
+
+  // Evicting a page cache mapping frees no frame, so keep going
+  while (kpage == NULL) {
     //printf("_vm_get_frame....evicting\n");
-    _vm_evict_frame(NULL);
+    if (!_vm_evict_frame(NULL))
+      wait_for_unpinned_frame();
     kpage = palloc_get_page(flags);
-    if (kpage == NULL)
-      PANIC("RACE CONDITION\n");
   }
     //PANIC("YOU NEED TO IMPLEMENT EVICTION\n");
   lock_release(&get_frame);
+  if (fs_locked)
+    lock_release(&fileSystemLock);
   return kpage;
 }
 
+// Returns true if some user frame is in use and every one in use is
+// pinned, being filled in or evicted. Caller must hold frame_table_lock.
+static bool all_frames_pinned(void) {
+  bool pinned = false;
+  size_t i;
+
+  for (i = 0; i < frame_cnt; i++) {
+    struct frame_table_entry *fte = &frame_table[i];
+    if (fte->frame != NULL) {
+      if (!fte->pinned)
+        return false;
+      pinned = true;
+    }
+  }
+  return pinned;
+}
+
+// Blocks while every user frame is pinned, so that a thread with nothing
+// to evict sleeps until a load or eviction finishes rather than spin.
+static void wait_for_unpinned_frame(void) {
+  lock_acquire(&frame_table_lock);
+  while (all_frames_pinned())
+    cond_wait(&frame_unpinned, &frame_table_lock);
+  lock_release(&frame_table_lock);
+}
+
+// Page cleaner thread. Sleeps until free user frames drop below
+// free_low, then evicts with the clock, writing dirty victims to swap or
+// their files, until free_high frames are free again. Faults under memory
+// pressure thus usually find a free frame without waiting for a write.
+static void page_cleaner(void *aux UNUSED) {
+  for (;;) {
+    lock_acquire(&cleaner_lock);
+    while (palloc_user_free_cnt() >= free_low)
+      cond_wait(&cleaner_cond, &cleaner_lock);
+    lock_release(&cleaner_lock);
+
+    // Stop early if nothing is evictable; the next allocation wakes us.
+    while (palloc_user_free_cnt() < free_high && _vm_evict_frame(NULL))
+      continue;
+  }
+}
+
 struct mmap_file *vm_install_mmap(void *vaddr_base, struct file *file, int fd) {
 
   ASSERT(pg_ofs(vaddr_base) == 0);
@@ -200,7 +706,7 @@ struct mmap_file *vm_install_mmap(void *vaddr_base, struct file *file, int fd) {
   for (i = 0; i < pages_taken; i++) {
     off_t read_bytes = (file_l - PGSIZE * i) > PGSIZE ? PGSIZE : (file_l - PGSIZE * i);
 
-    struct sPageTableEntry *spte = getCustomSupPTE(vaddr_base + i * PGSIZE, LOC_MMAP, mmap_file, i * PGSIZE, read_bytes, 0);
+    struct sPageTableEntry *spte = getCustomSupPTE(vaddr_base + i * PGSIZE, LOC_MMAP | LOC_SHRD, mmap_file, i * PGSIZE, read_bytes, 0);
     hash_insert(&t->s_pte, &spte->hash_elem);
   }
 
@@ -239,32 +745,72 @@ bool vm_muunmap_helper(struct mmap_file *mmf) {
 
 
 
-struct frame_table_entry *_vm_malloc_fte(uint32_t *frame, struct sPageTableEntry *spte) {
-  struct frame_table_entry *fte = malloc(sizeof(struct frame_table_entry));
+// Claims the frame table entry for FRAME, holding SPTE's page for the
+// current thread. A user frame's entry is its slot in the table; a page
+// cache page gets an entry of its own. Either way the clock leaves the
+// entry alone until frame_table_add() publishes it, so the page can be
+// filled in first.
+struct frame_table_entry *_vm_claim_fte(uint32_t *frame, struct sPageTableEntry *spte, bool cached) {
+  struct frame_table_entry *fte;
 
-  if (fte == NULL)
-    PANIC("NO MORE ARENAS COULD BE ALLOCATED @ MALLOC");
+  if (cached) {
+    fte = malloc(sizeof(struct frame_table_entry));
+    if (fte == NULL)
+      PANIC("NO MORE ARENAS COULD BE ALLOCATED @ MALLOC");
+  } else {
+    size_t idx = ((uint8_t *) frame - user_base) / PGSIZE;
+
+    ASSERT((uint8_t *) frame >= user_base && idx < frame_cnt);
+    fte = &frame_table[idx];
+    ASSERT(fte->frame == NULL);
+  }
 
-  fte->frame = frame;
   fte->owner = thread_current();
   fte->aux = spte;
+  fte->cached = cached;
+  fte->pinned = true;
+  fte->shared = false;
+
+  lock_acquire(&frame_table_lock);
+  fte->frame = frame;
+  lock_release(&frame_table_lock);
 
   return fte;
 }
 
+// Makes FTE, claimed with _vm_claim_fte(), a candidate for eviction.
+static void frame_table_add(struct frame_table_entry *fte) {
+  lock_acquire(&frame_table_lock);
+  if (fte->cached)
+    list_push_back(&cache_mappings, &fte->elem);
+  frame_unpin(fte);
+  lock_release(&frame_table_lock);
+}
+
 
+// Saves FTE's page, if it needs saving, before its frame is reused.
+// Anonymous pages, zero-fill pages among them once they have a frame,
+// go to swap. Clean file pages, all code included, are read again on
+// the next fault. A dirty mmap() page goes back to its file; a dirty
+// executable page goes to swap, since the executable must not change.
 void _vm_evict_write_back(struct frame_table_entry *fte) {
 
   ASSERT (fte != NULL && fte->aux != NULL);
 
-  if (fte->aux->location & LOC_SWAP)
+  struct sPageTableEntry *spte = fte->aux;
+  bool dirty = spte->dirty || pagedir_is_dirty(fte->owner->pagedir, spte->user_vaddr);
+
+  if (spte->location & LOC_SWAP) {
     _vm_write_back_to_disk(fte);
-  else if ((fte->aux->location & LOC_MMAP) && ((fte->aux->dirty == true) || pagedir_is_dirty(thread_current()->pagedir, fte->aux->user_vaddr)))
+  } else if (!dirty) {
+    spte->fte = NULL;
+  } else if ((spte->location & LOC_MMAP) && !(spte->location & LOC_EXEC)) {
     _vm_write_back_to_file(fte);
-  else if (fte->aux->location & LOC_ZERO) //Zeroed page...
-    fte->aux->fte = NULL;
-  // else
-  //   PANIC ("Couldn't locate where to write frame data.");
+    spte->dirty = false;
+  } else {
+    spte->location = LOC_SWAP;
+    _vm_write_back_to_disk(fte);
+  }
 }
 
 void _vm_write_back_to_disk(struct frame_table_entry *fte) {
@@ -272,10 +818,25 @@ void _vm_write_back_to_disk(struct frame_table_entry *fte) {
   ASSERT (fte != NULL && fte->aux != NULL);
   ASSERT (fte->aux->location & LOC_SWAP);
 
-  fte->aux->fte = NULL;
-  size_t block_index = write_to_block(fte->frame);
+  // Put the page next to the slot of the owner's last swapped-out page
+  // if it was that page's neighbour, so that a later fault can read both
+  // back in one request.
+  struct thread *owner = fte->owner;
+  uint8_t *upage = (uint8_t *) fte->aux->user_vaddr;
+  uint8_t *last = owner->swap_hint_page;
+  size_t hint = BITMAP_ERROR;
+  if (last != NULL && upage == last + PGSIZE)
+    hint = owner->swap_hint_slot + 1;
+  else if (last != NULL && upage == last - PGSIZE)
+    hint = owner->swap_hint_slot - 1;
+
+  size_t block_index = write_to_block_near(fte->frame, hint);
+  owner->swap_hint_page = upage;
+  owner->swap_hint_slot = block_index;
+
   fte->aux->location = LOC_SWAP;
   fte->aux->disk_offset = block_index;
+  fte->aux->fte = NULL;
 }
 
 void _vm_write_back_to_file(struct frame_table_entry *fte) {
@@ -285,9 +846,10 @@ void _vm_write_back_to_file(struct frame_table_entry *fte) {
   ASSERT(pg_ofs(fte->frame) == 0);
   ASSERT(fte->aux->location & LOC_MMAP);
   ASSERT(fte->aux->file != NULL);
+  ASSERT(lock_held_by_current_thread(&fileSystemLock));
 
   fte->aux->fte = NULL;
-  struct file *file = file_reopen(fte->aux->file);
+  struct file *file = fte->aux->file;
 
   off_t bytes_written = file_write_at(file, fte->frame, fte->aux->read_bytes, fte->aux->file_offset);
 
@@ -297,35 +859,476 @@ void _vm_write_back_to_file(struct frame_table_entry *fte) {
 
     printf("_vm_write_back_to_file ERROR... bytes_written: %d \t expected_written: %d\n", bytes_written, fte->aux->read_bytes);
   }
+}
+
+// Takes FTE out of the clock's reach while it is being evicted.
+// Caller must hold frame_table_lock.
+static void frame_table_remove(struct frame_table_entry *fte) {
+  ASSERT(!fte->pinned);
+
+  fte->pinned = true;
+  if (fte->cached)
+    list_remove(&fte->elem);
+}
+
+// Unpins FTE and wakes threads waiting for that. Caller must hold
+// frame_table_lock.
+static void frame_unpin(struct frame_table_entry *fte) {
+  fte->pinned = false;
+  cond_broadcast(&frame_unpinned, &frame_table_lock);
+}
+
+// Releases FTE once its page is gone from memory.
+static void frame_table_free(struct frame_table_entry *fte) {
+  bool cached = fte->cached;
+
+  lock_acquire(&frame_table_lock);
+  if (cached)
+    cache_map_cnt--;
+  else
+    fte->frame = NULL;
+  cond_broadcast(&frame_unpinned, &frame_table_lock);
+  lock_release(&frame_table_lock);
+  if (cached)
+    free(fte);
+}
+
+// Returns true if evicting FTE means writing its page somewhere:
+// anonymous pages always go to swap, file pages only if modified.
+static bool frame_needs_write(struct frame_table_entry *fte) {
+  struct sPageTableEntry *spte = fte->aux;
+
+  // Shared text is clean; a copy-on-write page exists nowhere else.
+  if (fte->shared)
+    return fte->inode == NULL;
+  if (spte->location & LOC_SWAP)
+    return true;
+  return spte->dirty || pagedir_is_dirty(fte->owner->pagedir, spte->user_vaddr);
+}
+
+// Returns true if FTE's page was accessed through any of its mappings
+// since the last call, and clears the accessed bits. Caller must hold
+// frame_table_lock.
+static bool frame_test_and_clear_accessed(struct frame_table_entry *fte) {
+  struct list_elem *e;
+  bool accessed = false;
+
+  if (!fte->shared) {
+    accessed = pagedir_is_accessed(fte->owner->pagedir, fte->aux->user_vaddr);
+    pagedir_set_accessed(fte->owner->pagedir, fte->aux->user_vaddr, false);
+    return accessed;
+  }
+  for (e = list_begin(&fte->sharers); e != list_end(&fte->sharers); e = list_next(e)) {
+    struct sPageTableEntry *spte = list_entry(e, struct sPageTableEntry, rmap_elem);
+    if (pagedir_is_accessed(spte->owner->pagedir, spte->user_vaddr)) {
+      pagedir_set_accessed(spte->owner->pagedir, spte->user_vaddr, false);
+      accessed = true;
+    }
+  }
+  return accessed;
+}
+
+// Picks an eviction victim with the clock (second chance) algorithm
+// and removes it from the frame table. A frame whose page was accessed
+// since the hand last passed has its accessed bit cleared and is
+// skipped. Among the rest, a clean frame is taken as soon as one is
+// found; a frame that needs writing out is taken only after a whole
+// sweep turns up nothing clean. Returns NULL if every frame is free or
+// pinned. Caller must hold frame_table_lock.
+static struct frame_table_entry *clock_select(void) {
+  struct frame_table_entry *dirty_victim = NULL;
+  struct frame_table_entry *fte = NULL;
+  size_t n = frame_cnt;
+  size_t i;
+
+  // Two sweeps: the first may do nothing but clear accessed bits.
+  for (i = 0; i < 2 * n; i++) {
+    fte = &frame_table[clock_hand];
+    clock_hand = (clock_hand + 1) % frame_cnt;
+    if (fte->frame == NULL || fte->pinned) {
+      fte = NULL;
+      continue;
+    }
+
+    if (frame_test_and_clear_accessed(fte))
+      continue;
+
+    if (!frame_needs_write(fte))
+      break;
+    if (dirty_victim == NULL)
+      dirty_victim = fte;
+    if (i + 1 >= n) {
+      fte = dirty_victim;
+      break;
+    }
+  }
+  // Pages kept being touched faster than the hand went around.
+  if (i == 2 * n && dirty_victim != NULL)
+    fte = dirty_victim;
+
+  if (fte != NULL)
+    frame_table_remove(fte);
+  return fte;
+}
 
-  file_close(file);
+// Acquires fileSystemLock unless the current thread holds it already, as
+// it does when a system call faults. Returns true if it was acquired, for
+// the caller to release.
+static bool fs_lock_acquire(void) {
+  if (lock_held_by_current_thread(&fileSystemLock))
+    return false;
+  lock_acquire(&fileSystemLock);
+  return true;
 }
 
-//Implementing LRA (last recently added)
-// will add LRU / clock at the end
-void _vm_evict_frame(struct frame_table_entry *fte) {
+// Evicts FTE, or a victim chosen by clock_select() if FTE is null.
+// Returns true if a frame was evicted, false if there was nothing to do.
+bool _vm_evict_frame(struct frame_table_entry *fte) {
+  // A dirty mmap() page is written to its file like write() would, under
+  // fileSystemLock. It is taken before the victim is pinned: a system call
+  // holding it may be waiting for that very page.
+  bool fs_locked = fs_lock_acquire();
+  bool evicted = evict_frame(fte);
+
+  if (fs_locked)
+    lock_release(&fileSystemLock);
+  return evicted;
+}
 
-  // printf("EVICTING FRAME\n");
+// Does the work of _vm_evict_frame(), with fileSystemLock held.
+static bool evict_frame(struct frame_table_entry *fte) {
+  lock_acquire(&frame_table_lock);
   if (fte == NULL) {
-    ASSERT(list_begin(&frame_table) != NULL);
+    fte = clock_select();
+  } else if (fte->pinned) {
+    // Already on its way out.
+    lock_release(&frame_table_lock);
+    return false;
+  } else {
+    frame_table_remove(fte);
+  }
+  lock_release(&frame_table_lock);
+
+  if (fte == NULL)
+    return false;
+
+  if (fte->cached) {
+    evict_cache_mapping(fte);
+    return true;
+  }
+
+  uint32_t *frame = fte->frame;
+
+  if (fte->shared) {
+    // Unmap the page from every process through the reverse map. Shared
+    // text is never dirty, and each process faults it back in from the
+    // file. A copy-on-write page goes to swap once, in a slot that all
+    // of its sharers refer to.
+    size_t slot = fte->inode == NULL ? write_to_block(frame) : BITMAP_ERROR;
+    int refs = 0;
 
     lock_acquire(&frame_table_lock);
-    fte = list_entry(list_pop_front(&frame_table), struct frame_table_entry, elem);
+    while (!list_empty(&fte->sharers)) {
+      struct sPageTableEntry *spte = list_entry(list_pop_front(&fte->sharers), struct sPageTableEntry, rmap_elem);
+      pagedir_clear_page(spte->owner->pagedir, spte->user_vaddr);
+      spte->fte = NULL;
+      if (slot != BITMAP_ERROR) {
+        if (refs++ > 0)
+          share_block(slot);
+        spte->location = LOC_SWAP;
+        spte->disk_offset = slot;
+      }
+    }
+    fte->share_cnt = 0;
+    if (fte->inode != NULL)
+      hash_delete(&shared_frames, &fte->hash_elem);
+    fte->frame = NULL;
+    cond_broadcast(&frame_unpinned, &frame_table_lock);
     lock_release(&frame_table_lock);
+
+    // Every sharer exited while the page was being written.
+    if (slot != BITMAP_ERROR && refs == 0)
+      free_block(slot);
+    palloc_free_page(frame);
+    return true;
   }
 
   pagedir_clear_page(fte->owner->pagedir, fte->aux->user_vaddr);
   _vm_evict_write_back(fte);
-  palloc_free_page(fte->frame);
-  free(fte);
+  // Free the entry first: once the frame is free, its slot may be claimed.
+  frame_table_free(fte);
+  palloc_free_page(frame);
+  return true;
+}
+
+// Returns true if a frame of T's is pinned, that is, being evicted. Caller
+// must hold frame_table_lock.
+static bool evicting_frame_of(struct thread *t) {
+  size_t i;
+
+  for (i = 0; i < frame_cnt; i++) {
+    struct frame_table_entry *fte = &frame_table[i];
+    if (fte->frame != NULL && fte->pinned && !fte->shared && fte->owner == t)
+      return true;
+  }
+  return false;
+}
+
+// Releases every frame and swap slot owned by T. Private pages die with
+// it, so nothing is written to swap. Called on process exit, before the page
+// directory is destroyed, so that the frame table never refers to a
+// dead thread.
+void vm_free_thread_frames(struct thread *t) {
+  struct list dead;
+  struct list_elem *e;
+  struct hash_iterator it;
+  size_t i;
+
+  list_init(&dead);
+  lock_acquire(&frame_table_lock);
+  // Evictions of our frames already under way, by the page cleaner or
+  // another process, use our page directory: let them finish.
+  while (evicting_frame_of(t))
+    cond_wait(&frame_unpinned, &frame_table_lock);
+  for (e = list_begin(&cache_mappings); e != list_end(&cache_mappings); ) {
+    struct frame_table_entry *fte = list_entry(e, struct frame_table_entry, elem);
+    e = list_next(e);
+    if (fte->owner == t) {
+      frame_table_remove(fte);
+      list_push_back(&dead, &fte->elem);
+    }
+  }
+  for (i = 0; i < frame_cnt; i++) {
+    struct frame_table_entry *fte = &frame_table[i];
+    if (fte->frame != NULL && !fte->pinned && fte->owner == t) {
+      frame_table_remove(fte);
+      list_push_back(&dead, &fte->elem);
+    }
+  }
+  lock_release(&frame_table_lock);
+
+  // Swapped-out pages die too, and shared text loses a mapping. Pages in
+  // DEAD still have their frames, so their slots, if any, are not freed.
+  hash_first(&it, &t->s_pte);
+  while (hash_next(&it)) {
+    struct sPageTableEntry *spte = hash_entry(hash_cur(&it), struct sPageTableEntry, hash_elem);
+    struct frame_table_entry *fte = spte->fte;
+    if ((spte->location & LOC_SWAP) && fte == NULL)
+      free_block(spte->disk_offset);
+    else if (fte != NULL && fte->shared)
+      shared_detach(spte);
+    else if (spte->location == LOC_ZERO && fte == NULL)
+      // Keep pagedir_destroy() from freeing the zero frame.
+      pagedir_clear_page(t->pagedir, spte->user_vaddr);
+  }
+
+  while (!list_empty(&dead)) {
+    struct frame_table_entry *fte = list_entry(list_pop_front(&dead), struct frame_table_entry, elem);
+    struct sPageTableEntry *spte = fte->aux;
+
+    bool dirty = spte->dirty || pagedir_is_dirty(t->pagedir, spte->user_vaddr);
+
+    pagedir_clear_page(t->pagedir, spte->user_vaddr);
+    spte->fte = NULL;
+    uint32_t *frame = fte->frame;
+    bool cached = fte->cached;
+
+    frame_table_free(fte);
+    if (cached)
+      cache_unmap(file_get_inode(spte->file), spte->file_offset, spte->writable, dirty);
+    else
+      palloc_free_page(frame);
+  }
+}
+
+// Gives CHILD's copy of PARENT's page PSPTE, CSPTE, the same contents.
+// A page in a private frame becomes shared copy-on-write: read-only in
+// both page tables until one of them writes to it. Shared frames gain
+// a mapping. Pages out of memory are found by the child where the parent
+// would find them, with swap slots shared. Returns false if out of
+// memory.
+static bool fork_page(struct sPageTableEntry *pspte, struct sPageTableEntry *cspte) {
+  struct thread *parent = pspte->owner;
+  struct thread *child = cspte->owner;
+  void *upage = pspte->user_vaddr;
+  struct frame_table_entry *fte;
+  bool success = true;
+
+  lock_acquire(&frame_table_lock);
+  // Wait out an eviction.
+  while ((fte = pspte->fte) != NULL && fte->pinned)
+    cond_wait(&frame_unpinned, &frame_table_lock);
+
+  if (fte == NULL) {
+    if (pspte->location & LOC_SWAP)
+      share_block(pspte->disk_offset);
+  } else if (fte->cached || (pspte->location & LOC_SHRD)) {
+    // mmap()'d page: the child maps the file's copy on first access.
+  } else {
+    if (!fte->shared) {
+      pspte->dirty = pspte->dirty || pagedir_is_dirty(parent->pagedir, upage);
+      cspte->dirty = pspte->dirty;
+      fte->shared = true;
+      fte->owner = NULL;
+      fte->aux = NULL;
+      fte->inode = NULL;
+      list_init(&fte->sharers);
+      fte->share_cnt = 0;
+      shared_attach(fte, pspte);
+      pagedir_set_writable(parent->pagedir, upage, false);
+    }
+    success = pagedir_set_page(child->pagedir, upage, fte->frame, false);
+    if (success)
+      shared_attach(fte, cspte);
+  }
+  lock_release(&frame_table_lock);
+
+  return success;
+}
+
+// Gives CHILD, a new process with an empty page table, a copy-on-write
+// copy of PARENT's address space. PARENT must be blocked until this
+// returns. Returns false if out of memory, in which case the child has
+// a partial copy that vm_free_thread_frames() releases as usual.
+bool vm_fork(struct thread *parent, struct thread *child) {
+  struct hash_iterator it;
+
+  hash_first(&it, &parent->s_pte);
+  while (hash_next(&it)) {
+    struct sPageTableEntry *pspte = hash_entry(hash_cur(&it), struct sPageTableEntry, hash_elem);
+    struct sPageTableEntry *cspte = malloc(sizeof *cspte);
+
+    if (cspte == NULL)
+      return false;
+    *cspte = *pspte;
+    cspte->owner = child;
+    cspte->fte = NULL;
+    hash_insert(&child->s_pte, &cspte->hash_elem);
+    if (!fork_page(pspte, cspte)) {
+      hash_delete(&child->s_pte, &cspte->hash_elem);
+      free(cspte);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Gives SPTE sole use of shared copy-on-write frame FTE, if no one else
+// maps it any more, and returns true. Caller must hold frame_table_lock
+// and make the page writable.
+static bool make_private(struct frame_table_entry *fte, struct sPageTableEntry *spte) {
+  if (fte->share_cnt != 1)
+    return false;
+  list_remove(&spte->rmap_elem);
+  fte->shared = false;
+  fte->share_cnt = 0;
+  fte->owner = spte->owner;
+  fte->aux = spte;
+  return true;
 }
 
-void vm_grow_stack(uint32_t *fault_addr) {
+// Handles a write fault at FAULT_ADDR on a present page. If the page is
+// writable but shared copy-on-write, gives the current thread a private
+// copy, or just write access if no one else maps it any more, and
+// returns true so that the write is retried. A page mapping the zero frame
+// gets a zeroed frame of its own. Returns false if the write is an error.
+bool vm_cow_fault(void *fault_addr) {
+  struct thread *t = thread_current();
+  struct sPageTableEntry *spte;
+  struct frame_table_entry *fte, *copy;
+  uint32_t *frame, *old = NULL;
+  void *upage;
+
+  if (!is_user_vaddr(fault_addr))
+    return false;
+  upage = pg_round_down(fault_addr);
+  spte = page_lookup(upage, &t->s_pte);
+  if (spte == NULL || !spte->writable)
+    return false;
+
+  // Only this thread maps or unmaps the zero frame in its page table, so
+  // no lock is needed to see it there.
+  if (spte->fte == NULL && pagedir_get_page(t->pagedir, upage) == zero_frame) {
+    frame = _vm_get_frame(PAL_USER | PAL_ZERO);
+    fte = _vm_claim_fte(frame, spte, false);
+    spte->fte = fte;
+    spte->location = LOC_SWAP;
+    pagedir_clear_page(t->pagedir, upage);
+    pagedir_set_page(t->pagedir, upage, frame, true);
+    frame_table_add(fte);
+    return true;
+  }
+
+  lock_acquire(&frame_table_lock);
+  fte = spte->fte;
+  if (fte != NULL && fte->pinned) {
+    // Being evicted: wait, then retry, faulting the page back in.
+    while (spte->fte == fte && fte->pinned)
+      cond_wait(&frame_unpinned, &frame_table_lock);
+    lock_release(&frame_table_lock);
+    return true;
+  }
+  if (fte == NULL || !fte->shared) {
+    // Evicted: retry.
+    lock_release(&frame_table_lock);
+    return true;
+  }
+  if (make_private(fte, spte)) {
+    lock_release(&frame_table_lock);
+    pagedir_set_writable(t->pagedir, upage, true);
+    return true;
+  }
+  lock_release(&frame_table_lock);
+
+  // Take the frame for the copy before looking at the shared one again:
+  // getting it may evict, and that frame may be the one.
+  frame = _vm_get_frame(PAL_USER);
+  copy = _vm_claim_fte(frame, spte, false);
+
+  lock_acquire(&frame_table_lock);
+  if (spte->fte != fte || fte->pinned || make_private(fte, spte)) {
+    // Evicted, or left to us by the other sharers, meanwhile: no copy.
+    bool private = spte->fte == fte && !fte->shared;
+    lock_release(&frame_table_lock);
+    frame_table_free(copy);
+    palloc_free_page(frame);
+    if (private)
+      pagedir_set_writable(t->pagedir, upage, true);
+    return true;
+  }
+  // Copy under the lock, so that the frame cannot be evicted meanwhile.
+  memcpy(frame, fte->frame, PGSIZE);
+  list_remove(&spte->rmap_elem);
+  spte->fte = copy;
+  // The other sharers may have exited meanwhile.
+  if (--fte->share_cnt == 0) {
+    old = fte->frame;
+    fte->frame = NULL;
+  }
+  lock_release(&frame_table_lock);
+
+  pagedir_clear_page(t->pagedir, upage);
+  pagedir_set_page(t->pagedir, upage, frame, true);
+  frame_table_add(copy);
+  if (old != NULL)
+    palloc_free_page(old);
+  return true;
+}
+
+void vm_grow_stack(uint32_t *fault_addr, bool write) {
   struct thread *t = thread_current();
   uint32_t *fault_addr_rd = pg_round_down(fault_addr);
 
   ASSERT(page_lookup(fault_addr_rd, &t->s_pte) == NULL);
 
+  // A stack page that is only read so far maps the zero frame.
+  if (!write) {
+    struct sPageTableEntry *spte = getSupPTE(fault_addr_rd);
+    hash_insert(&t->s_pte, &spte->hash_elem);
+    vm_load_install(fault_addr, spte, false);
+    return;
+  }
+
   //aka *kpage
   uint32_t *frame = _vm_get_frame(PAL_USER | PAL_ZERO);
 
@@ -333,16 +1336,15 @@ void vm_grow_stack(uint32_t *fault_addr) {
   // struct sPageTableEntry *spte = getCustomSupPTE(fault_addr_rd, LOC_FRME, NULL, 0, 0);
   // struct frame_table_entry *fte = _vm_malloc_fte(fault_addr_rd, spte);
   struct sPageTableEntry *spte = getCustomSupPTE(fault_addr_rd, LOC_SWAP, NULL, 0, 0, 0);
-  struct frame_table_entry *fte = _vm_malloc_fte(frame, spte);
+  struct frame_table_entry *fte = _vm_claim_fte(frame, spte, false);
 
   spte->fte = fte;
+  hash_insert(&t->s_pte, &spte->hash_elem);
 
   if (!install_page(fault_addr_rd, frame, true))
     PANIC("Couldn't install stack frame");
 
-  lock_acquire(&frame_table_lock);
-  list_push_back(&frame_table, &fte->elem);
-  lock_release(&frame_table_lock);
+  frame_table_add(fte);
 
 }
 
@@ -360,16 +1362,15 @@ void* vm_grow_stack_bandaid(uint32_t *fault_addr) {
   // struct sPageTableEntry *spte = getCustomSupPTE(fault_addr_rd, LOC_FRME, NULL, 0, 0);
   // struct frame_table_entry *fte = _vm_malloc_fte(fault_addr_rd, spte);
   struct sPageTableEntry *spte = getCustomSupPTE(fault_addr_rd, LOC_SWAP, NULL, 0, 0, 0);
-  struct frame_table_entry *fte = _vm_malloc_fte(frame, spte);
+  struct frame_table_entry *fte = _vm_claim_fte(frame, spte, false);
 
   spte->fte = fte;
+  hash_insert(&t->s_pte, &spte->hash_elem);
 
   // if (!install_page(fault_addr_rd, frame, true))
   //   PANIC("Couldn't install stack frame");
 
-  lock_acquire(&frame_table_lock);
-  list_push_back(&frame_table, &fte->elem);
-  lock_release(&frame_table_lock);
+  frame_table_add(fte);
 
   return frame;
 }
@@ -1,6 +1,9 @@
 #ifndef VM_FRAME_H
 #define VM_FRAME_H
 
+#include <hash.h>
+#include <list.h>
+#include "filesys/off_t.h"
 #include "threads/palloc.h"
 #include "userprog/syscall.h"
 
@@ -10,24 +13,44 @@
 ../../vm/frame.h:15: warning: its scope is only this definition or declaration, which is probably not what you want
 */
 struct frame_table_entry {
-  uint32_t *frame;
+  uint32_t *frame;             /* kernel address of the frame, or NULL if unused */
   struct thread *owner;
   struct sPageTableEntry *aux;
-  struct list_elem elem;
+  bool cached;                 /* frame belongs to the page cache */
+  bool pinned;                 /* being filled in or evicted: not a victim */
+  struct list_elem elem;       /* cache_mappings element, if cached */
+
+  /* A read-only page of an executable is shared by every process
+     running it, and a writable page by a process and its fork()ed
+     children until one of them writes to it.  Such a frame has no
+     single OWNER or AUX; instead SHARERS lists the SPTE of every
+     mapping (a reverse map), and the frame is freed when the last
+     one goes. */
+  bool shared;
+  struct list sharers;         /* shared: SPTEs mapping the frame */
+  int share_cnt;               /* shared: length of SHARERS */
+  struct inode *inode;         /* shared: executable the page came from,
+                                  or NULL if shared copy-on-write, */
+  off_t offset;                /*   offset of the page in it, */
+  off_t read_bytes;            /*   and bytes read from there */
+  struct hash_elem hash_elem;  /* shared: element in shared_frames */
 };
 
 void frame_init(void);
 bool vm_free_frame(void *);
 //void* vm_get_no_pf_frame(enum palloc_flags);
-void vm_grow_stack (uint32_t *);
-struct frame_table_entry *vm_find_in_list(uint32_t *vpage_base);
-void vm_load_install (uint32_t *, struct sPageTableEntry *);
+void vm_grow_stack (uint32_t *, bool write);
+struct frame_table_entry *vm_find_frame(uint32_t *kpage);
+void vm_load_install (uint32_t *, struct sPageTableEntry *, bool write);
 
 void _vm_load_from_file (uint32_t *, struct frame_table_entry *);
 void _vm_load_from_disk (uint32_t *, struct frame_table_entry *);
 uint32_t *_vm_get_frame (enum palloc_flags);
 
-void _vm_evict_frame(struct frame_table_entry *);
+bool _vm_evict_frame(struct frame_table_entry *);
+void vm_free_thread_frames(struct thread *);
+bool vm_fork(struct thread *parent, struct thread *child);
+bool vm_cow_fault(void *fault_addr);
 void _vm_write_back_to_disk (struct frame_table_entry *);
 void _vm_write_back_to_file (struct frame_table_entry *);
 void _vm_evict_write_back (struct frame_table_entry *);
@@ -36,7 +59,7 @@ void* vm_grow_stack_bandaid(uint32_t *fault_addr);
 
 struct mmap_file *vm_install_mmap(void *, struct file *, int);
 bool vm_muunmap_helper(struct mmap_file *mmf);
-struct frame_table_entry *_vm_malloc_fte (uint32_t *, struct sPageTableEntry *);
+struct frame_table_entry *_vm_claim_fte (uint32_t *, struct sPageTableEntry *, bool cached);
 struct mmap_file *_vm_malloc_mmap(void *, int, int, struct thread *, int);
 
 #endif /* vm/frame.h */
@@ -19,6 +19,8 @@ struct sPageTableEntry *getCustomSupPTE(uint32_t *user_vaddr, uint8_t location,
   spte->disk_offset = disk_offset;
   spte->fte = NULL;
   spte->dirty = false;
+  spte->writable = true;
+  spte->owner = thread_current();
   return spte;
 }
 
@@ -3,11 +3,14 @@
 
 #include "filesys/off_t.h"
 #include <hash.h>
+#include <list.h>
 
 #define LOC_ZERO 0x00
 #define LOC_SWAP 0x01
 #define LOC_MMAP 0x02
 #define LOC_FRME 0x04
+#define LOC_SHRD 0x08   /* mmap()'d: map the page cache's copy */
+#define LOC_EXEC 0x10   /* from the executable: never written back to it */
 
 #define setLocation(n, val) ((val) |= (1 << (n)))
 #define clrLocation(n, val) ((val) &= ~((1 << (n)))
@@ -19,8 +22,11 @@ struct sPageTableEntry {
   struct file *file;             /* FP */
   off_t file_offset;             /* FP Offset */
   off_t read_bytes;              /* disk read bytes */
-  size_t disk_offset;            /* disk Offset */
+  size_t disk_offset;            /* swap slot, if swapped out */
   bool dirty;
+  bool writable;                 /* mapped writable? */
+  struct thread *owner;          /* thread whose address space holds the page */
+  struct list_elem rmap_elem;    /* in a shared frame's sharers list */
   struct frame_table_entry *fte; /*Frame Table Entry*/
   // struct thread *t thread_current
   //bool dirty;
@@ -1,43 +1,162 @@
 #include <bitmap.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "vm/swap.h"
 #include "lib/debug.h"
 #include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
+
+// Swap is handed out in page-sized slots. Slot i holds sectors
+// [i * SECTORS_PER_SLOT, (i + 1) * SECTORS_PER_SLOT) of the swap device,
+// and a page moves in one multi-sector request either way.
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+// Free slots are tracked a word at a time: bit b of slot_map[w] is set
+// if slot w * SLOT_BITS + b is in use.
+#define SLOT_BITS 32
 
 static struct block *global_swap_block;
-static struct bitmap *swap_bitmap;
+static uint32_t *slot_map;
+static size_t slot_cnt;       // usable slots
+static size_t word_cnt;       // words in slot_map
+static size_t next_word;      // where the next search starts
+// References to each in-use slot beyond the first, from pages shared
+// copy-on-write when they were swapped out. Also under bitmapLock.
+static uint16_t *slot_shares;
 static struct lock bitmapLock;
 
+// Staging area for reading a run of slots in one request.
+static uint8_t *cluster_buf;
+static struct lock cluster_lock;
+
 void swap_init(void) {
+  size_t i;
+
   global_swap_block = block_get_role(BLOCK_SWAP);
-  swap_bitmap = bitmap_create(block_size(global_swap_block));
+  slot_cnt = global_swap_block != NULL ? block_size(global_swap_block) / SECTORS_PER_SLOT : 0;
+  word_cnt = (slot_cnt + SLOT_BITS - 1) / SLOT_BITS;
+  slot_map = calloc(word_cnt > 0 ? word_cnt : 1, sizeof *slot_map);
+  slot_shares = calloc(slot_cnt > 0 ? slot_cnt : 1, sizeof *slot_shares);
+  if (slot_map == NULL || slot_shares == NULL)
+    PANIC("swap slot map allocation failed");
+
+  // Bits past the last slot are permanently in use.
+  for (i = slot_cnt; i < word_cnt * SLOT_BITS; i++)
+    slot_map[i / SLOT_BITS] |= 1u << (i % SLOT_BITS);
+
+  next_word = 0;
   lock_init(&bitmapLock);
+
+  if (slot_cnt > 0)
+    cluster_buf = palloc_get_multiple(PAL_ASSERT, SWAP_CLUSTER_MAX);
+  lock_init(&cluster_lock);
 }
 
-size_t write_to_block(uint32_t *frame) {
-  //@ 2^9 @ 512 B sector vs 4096 page 2 2^12
+// Allocates a free slot and returns it, or BITMAP_ERROR if swap is full.
+// Takes slot HINT if it is free. Otherwise searches from where the last
+// search left off, so in the common case the first word it looks at has
+// a free bit.
+static size_t slot_alloc(size_t hint) {
+  size_t i;
 
   lock_acquire(&bitmapLock);
-  size_t idx = bitmap_scan_and_flip (swap_bitmap, 0, 8, false);
+  if (hint < slot_cnt && !(slot_map[hint / SLOT_BITS] & (1u << (hint % SLOT_BITS)))) {
+    slot_map[hint / SLOT_BITS] |= 1u << (hint % SLOT_BITS);
+    lock_release(&bitmapLock);
+    return hint;
+  }
+  for (i = 0; i < word_cnt; i++) {
+    size_t w = (next_word + i) % word_cnt;
+
+    if (slot_map[w] != UINT32_MAX) {
+      int b = __builtin_ctz(~slot_map[w]);
+
+      slot_map[w] |= 1u << b;
+      next_word = w;
+      lock_release(&bitmapLock);
+      return w * SLOT_BITS + b;
+    }
+  }
   lock_release(&bitmapLock);
+  return BITMAP_ERROR;
+}
+
+size_t write_to_block(uint32_t *frame) {
+  return write_to_block_near(frame, BITMAP_ERROR);
+}
 
-  if (idx == BITMAP_ERROR)
+// Like write_to_block(), but puts the page in slot HINT if that is free,
+// so that pages evicted one after another from adjacent addresses land in
+// adjacent slots and can be read back with read_run_from_block().
+size_t write_to_block_near(uint32_t *frame, size_t hint) {
+  size_t slot = slot_alloc(hint);
+
+  if (slot == BITMAP_ERROR)
     PANIC ("SWAP DISK SPACE EXHAUSTED");
-  int i = 0;
-  for (; i < 8; i++)
-    block_write(global_swap_block, i + idx, frame + (512 * i));
-  return idx;
+  block_write_multiple(global_swap_block, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT, frame);
+  return slot;
+}
+
+// Like write_to_block(), but returns BITMAP_ERROR instead of panicking
+// when swap is full.
+size_t try_write_to_block(uint32_t *frame) {
+  size_t slot = slot_alloc(BITMAP_ERROR);
+
+  if (slot == BITMAP_ERROR)
+    return slot;
+  block_write_multiple(global_swap_block, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT, frame);
+  return slot;
+}
+
+void read_from_block(uint32_t *frame, int slot) {
+  block_read_multiple(global_swap_block, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT, frame);
+  free_block(slot);
+}
+
+// Reads the CNT pages in consecutive slots starting at SLOT into
+// FRAMES[0] through FRAMES[CNT - 1] with a single request, and frees
+// the slots.
+void read_run_from_block(uint32_t **frames, size_t slot, size_t cnt) {
+  size_t i;
+
+  ASSERT(cnt <= SWAP_CLUSTER_MAX);
+
+  lock_acquire(&cluster_lock);
+  block_read_multiple(global_swap_block, slot * SECTORS_PER_SLOT, cnt * SECTORS_PER_SLOT, cluster_buf);
+  for (i = 0; i < cnt; i++)
+    memcpy(frames[i], cluster_buf + i * PGSIZE, PGSIZE);
+  lock_release(&cluster_lock);
+
+  for (i = 0; i < cnt; i++)
+    free_block(slot + i);
 }
 
-void read_from_block(uint32_t *frame, int idx) {
-  int i = 0;
-  for (; i < 8; i++)
-    block_read(global_swap_block, idx + i, frame + (512 * i));
+// Adds a reference to in-use SLOT, so that it takes one more
+// free_block(), read_from_block() or read_run_from_block() to free it.
+void share_block(size_t slot) {
+  ASSERT(slot < slot_cnt);
 
   lock_acquire(&bitmapLock);
-  bitmap_set_multiple(swap_bitmap, idx, 8, false);
+  ASSERT(slot_map[slot / SLOT_BITS] & (1u << (slot % SLOT_BITS)));
+  ASSERT(slot_shares[slot] < UINT16_MAX);
+  slot_shares[slot]++;
   lock_release(&bitmapLock);
+}
 
+// Drops a reference to the slot without reading it back, releasing the
+// slot with the last one.
+void free_block(size_t slot) {
+  ASSERT(slot < slot_cnt);
 
+  lock_acquire(&bitmapLock);
+  ASSERT(slot_map[slot / SLOT_BITS] & (1u << (slot % SLOT_BITS)));
+  if (slot_shares[slot] > 0)
+    slot_shares[slot]--;
+  else
+    slot_map[slot / SLOT_BITS] &= ~(1u << (slot % SLOT_BITS));
+  lock_release(&bitmapLock);
 }
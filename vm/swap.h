@@ -1,8 +1,19 @@
 #ifndef VM_SWAP_H
 #define VM_SWAP_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+// Most pages read_run_from_block() reads at once.
+#define SWAP_CLUSTER_MAX 8
+
 void swap_init(void);
 void read_from_block(uint32_t *, int);
+void read_run_from_block(uint32_t **, size_t, size_t);
 size_t write_to_block(uint32_t *);
+size_t write_to_block_near(uint32_t *, size_t);
+size_t try_write_to_block(uint32_t *);
+void share_block(size_t);
+void free_block(size_t);
 
 #endif /* vm/swap.h */